@@ -0,0 +1,71 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - alignedallocator.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <malloc.h>
+#include <new>
+
+static const int CACHE_LINE_SIZE = 64;
+
+/**
+* Allocator for standard containers that aligns the start of the storage
+* @note Alignment must be a power of two
+*/
+template<typename T, int Alignment = CACHE_LINE_SIZE>
+class AlignedAllocator
+{
+public:
+
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    /**
+    * Allows the allocator to be used for other types
+    */
+    template<typename U> struct rebind
+    {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    /**
+    * Constructors
+    */
+    AlignedAllocator() {}
+    template<typename U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    /**
+    * Allocates aligned storage
+    * @param count The number of elements to allocate
+    * @return the allocated storage
+    */
+    T* allocate(size_t count)
+    {
+        void* memory = _aligned_malloc(count * sizeof(T), Alignment);
+        if(!memory)
+        {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(memory);
+    }
+
+    /**
+    * Releases aligned storage
+    * @param memory The storage to release
+    */
+    void deallocate(T* memory, size_t)
+    {
+        _aligned_free(memory);
+    }
+
+    /**
+    * Allocators are stateless and can release each other's storage
+    */
+    template<typename U> bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+    template<typename U> bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
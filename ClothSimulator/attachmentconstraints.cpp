@@ -0,0 +1,170 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - attachmentconstraints.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "attachmentconstraints.h"
+#include "particlestore.h"
+#include "springkernel.h"
+#include "threadpool.h"
+#include <queue>
+#include <cfloat>
+
+namespace
+{
+    const int MIN_PARALLEL_PARTICLES = 1024; ///< Smallest amount of particles worth splitting across threads
+}
+
+AttachmentConstraints::AttachmentConstraints(ThreadPool& threads) :
+    m_threads(threads),
+    m_pinChanges(-1)
+{
+}
+
+void AttachmentConstraints::Initialise(const PackedSprings& springs, int particleCount)
+{
+    const int springCount = static_cast<int>(springs.rest.size());
+
+    // Count the springs for each particle then prefix sum into start offsets
+    m_neighbourStart.assign(particleCount + 1, 0);
+    for(int i = 0; i < springCount; ++i)
+    {
+        ++m_neighbourStart[springs.index1[i] + 1];
+        ++m_neighbourStart[springs.index2[i] + 1];
+    }
+    for(int i = 1; i <= particleCount; ++i)
+    {
+        m_neighbourStart[i] += m_neighbourStart[i-1];
+    }
+
+    std::vector<int> fill(m_neighbourStart.begin(), m_neighbourStart.end()-1);
+    m_neighbours.resize(springCount * 2);
+    m_neighbourRest.resize(springCount * 2);
+    for(int i = 0; i < springCount; ++i)
+    {
+        const int index1 = springs.index1[i];
+        const int index2 = springs.index2[i];
+        m_neighbourRest[fill[index1]] = springs.rest[i];
+        m_neighbours[fill[index1]++] = index2;
+        m_neighbourRest[fill[index2]] = springs.rest[i];
+        m_neighbours[fill[index2]++] = index1;
+    }
+
+    m_attached.clear();
+    m_anchors.clear();
+    m_distances.clear();
+    m_pinChanges = -1;
+}
+
+void AttachmentConstraints::ScaleRestDistances(float scale)
+{
+    // Uniform scaling keeps the shortest paths so each distance scales with them
+    for(float& rest : m_neighbourRest)
+    {
+        rest *= scale;
+    }
+    for(float& distance : m_distances)
+    {
+        distance *= scale;
+    }
+}
+
+void AttachmentConstraints::Update(const ParticleStore& particles)
+{
+    if(m_pinChanges == particles.GetPinChanges())
+    {
+        return;
+    }
+    m_pinChanges = particles.GetPinChanges();
+
+    // Shortest paths along the springs from all pinned particles at once give
+    // each particle its nearest pin; the spring rest distances make the paths
+    // follow the cloth surface rather than cutting across any folds
+    typedef std::pair<float, int> QueueEntry;
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+
+    const int particleCount = static_cast<int>(m_neighbourStart.size()) - 1;
+    std::vector<float> distance(particleCount, FLT_MAX);
+    std::vector<int> anchor(particleCount, -1);
+    for(int i = 0; i < particleCount; ++i)
+    {
+        if(particles.HasFlag(i, ParticleStore::PINNED))
+        {
+            distance[i] = 0.0f;
+            anchor[i] = i;
+            queue.push(std::make_pair(0.0f, i));
+        }
+    }
+
+    while(!queue.empty())
+    {
+        const QueueEntry entry = queue.top();
+        queue.pop();
+
+        const int index = entry.second;
+        if(entry.first > distance[index])
+        {
+            continue;
+        }
+
+        for(int j = m_neighbourStart[index]; j < m_neighbourStart[index+1]; ++j)
+        {
+            const int neighbour = m_neighbours[j];
+            const float neighbourDistance = distance[index] + m_neighbourRest[j];
+            if(neighbourDistance < distance[neighbour])
+            {
+                distance[neighbour] = neighbourDistance;
+                anchor[neighbour] = anchor[index];
+                queue.push(std::make_pair(neighbourDistance, neighbour));
+            }
+        }
+    }
+
+    m_attached.clear();
+    m_anchors.clear();
+    m_distances.clear();
+    for(int i = 0; i < particleCount; ++i)
+    {
+        if(anchor[i] != -1 && anchor[i] != i)
+        {
+            m_attached.push_back(i);
+            m_anchors.push_back(anchor[i]);
+            m_distances.push_back(distance[i]);
+        }
+    }
+}
+
+void AttachmentConstraints::Solve(ParticleStore& particles)
+{
+    const int count = GetAttachedCount();
+    if(count < MIN_PARALLEL_PARTICLES)
+    {
+        SolveRange(particles, 0, count);
+    }
+    else
+    {
+        // Each attachment only moves its own particle and reads a pinned one
+        m_threads.ParallelFor(count, [&](int begin, int end)
+            { SolveRange(particles, begin, end); });
+    }
+}
+
+void AttachmentConstraints::SolveRange(ParticleStore& particles, int begin, int end) const
+{
+    for(int i = begin; i < end; ++i)
+    {
+        const int index = m_attached[i];
+        if(particles.GetInverseMass(index) == 0.0f)
+        {
+            continue;
+        }
+
+        const D3DXVECTOR3& anchor = particles.GetPosition(m_anchors[i]);
+        const D3DXVECTOR3 difference = particles.GetPosition(index) - anchor;
+        const float lengthSqr = D3DXVec3LengthSq(&difference);
+        if(lengthSqr > m_distances[i] * m_distances[i])
+        {
+            particles.SetPosition(index, anchor +
+                difference * (m_distances[i] / std::sqrt(lengthSqr)));
+        }
+    }
+}
@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - attachmentconstraints.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+
+class ParticleStore;
+class ThreadPool;
+struct PackedSprings;
+
+/**
+* Long range attachments keeping each free particle within its rest distance
+* over the cloth of the nearest pinned particle. Stretch from the pins then
+* cannot build up down the cloth however few spring iterations are used
+*/
+class AttachmentConstraints
+{
+public:
+
+    /**
+    * Constructor
+    * @param threads The threads to split the solve between
+    */
+    explicit AttachmentConstraints(ThreadPool& threads);
+
+    /**
+    * Builds the springs connected to each particle to measure distances over the cloth
+    * @param springs The packed data for all springs
+    * @param particleCount The number of particles
+    */
+    void Initialise(const PackedSprings& springs, int particleCount);
+
+    /**
+    * Scales the rest distances over the cloth for a uniformly scaled cloth
+    * @param scale The amount to scale by
+    */
+    void ScaleRestDistances(float scale);
+
+    /**
+    * Finds the nearest pinned particle of each free particle if any pins have changed
+    * @param particles The simulated state of all particles
+    */
+    void Update(const ParticleStore& particles);
+
+    /**
+    * Moves each free particle further than its rest distance from
+    * its pinned particle back onto the limit of that distance
+    * @param particles The simulated state of all particles
+    */
+    void Solve(ParticleStore& particles);
+
+    /**
+    * @return the number of free particles attached to a pinned particle
+    */
+    int GetAttachedCount() const { return static_cast<int>(m_attached.size()); }
+
+private:
+
+    /**
+    * Prevent copying
+    */
+    AttachmentConstraints(const AttachmentConstraints&) = delete;
+    AttachmentConstraints& operator=(const AttachmentConstraints&) = delete;
+
+    /**
+    * Limits the distance of a range of attached particles
+    * @param particles The simulated state of all particles
+    * @param begin/end The range of attached particles to limit
+    */
+    void SolveRange(ParticleStore& particles, int begin, int end) const;
+
+    ThreadPool& m_threads;                ///< Threads to split the solve between
+    std::vector<int> m_neighbourStart;    ///< Start of each particle's neighbours
+    std::vector<int> m_neighbours;        ///< Particles connected to each particle by a spring
+    std::vector<float> m_neighbourRest;   ///< Rest distance to each neighbour
+    std::vector<int> m_attached;          ///< Free particles which can reach a pinned particle
+    std::vector<int> m_anchors;           ///< Nearest pinned particle of each attached particle
+    std::vector<float> m_distances;       ///< Rest distance over the cloth to each anchor
+    int m_pinChanges;                     ///< Pin changes of the particles when last updated
+};
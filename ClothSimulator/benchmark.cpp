@@ -0,0 +1,753 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - benchmark.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "benchmark.h"
+#include "cloth.h"
+#include "collisionsolver.h"
+#include "springkernel.h"
+#include "particlestore.h"
+#include "particle.h"
+#include "collisionmesh.h"
+#include "chebyshevaccelerator.h"
+#include "shader.h"
+#include "timer.h"
+#include <crtdbg.h>
+
+namespace
+{
+    const int WARMUP_REPEATS = 2;    ///< Untimed repeats to warm caches before timing
+    const int TIMED_REPEATS = 10;    ///< Timed repeats averaged for a result
+    const int CLOTH_ROWS[] = { 20, 64, 128, 256 }; ///< Cloth sizes to benchmark
+    const int CONVERGENCE_ROWS[] = { 20, 64, 128 };  ///< Cloth sizes to measure convergence
+    const int CONVERGENCE_ITERATIONS[] = { 2, 8, 32 };  ///< Solver iterations to measure convergence
+    const float DISTURBANCE = 0.25f;  ///< Largest particle offset as a fraction of the spacing
+    const int IMPLICIT_ROWS[] = { 20, 64 };  ///< Cloth sizes to compare integration
+    const int MAX_EXPLICIT_ITERATIONS = 64;  ///< Most Gauss-Seidel iterations to try matching with
+    const int HANG_TICKS = 120;              ///< Ticks to simulate the hanging cloth for
+    const float HANG_DELTATIME = 1.0f / 60.0f; ///< Deltatime for each hanging tick
+    const int CHEBYSHEV_ROWS[] = { 20, 128 };  ///< Cloth sizes to measure acceleration
+    const int REFERENCE_ITERATIONS = 32;       ///< Plain iterations setting the stretch to reach
+    const int REBUILD_REPEATS = 4;             ///< Timed repeats averaged for a rebuild result
+    const int REBUILD_ROW_CHANGE = 2;          ///< Rows added and removed when rebuilding
+    const float REBUILD_SPACING_SCALE = 1.25f; ///< Spacing scale applied and removed when rebuilding
+    const int LAYOUT_ROWS[] = { 256, 512 };    ///< Cloth sizes to compare particle layouts
+    const int ATTACHMENT_ROWS[] = { 20, 64 };  ///< Cloth sizes to measure long range attachments
+    const int ATTACHMENT_ITERATIONS = 2;       ///< Iterations used with long range attachments
+    const int STRAIN_ROWS[] = { 20, 64 };      ///< Cloth sizes to measure strain limiting
+    const int STRAIN_ITERATIONS[] = { 2, 8 };  ///< Iterations used with strain limiting
+    const int DRAPE_ROWS[] = { 20, 64 };       ///< Cloth sizes to drape over the primitives
+    const D3DXVECTOR3 DRAPE_BOX_SCALE(4.0f, 4.0f, 4.0f);          ///< Scale of the box to drape over
+    const D3DXVECTOR3 DRAPE_CYLINDER_SCALE(2.25f, 2.25f, 8.0f);   ///< Scale of the cylinder to drape over
+    const int DRAPE_CYLINDER_DIVISIONS = 10;                      ///< Divisions of the cylinder mesh
+    const std::string DRAPE_HULL_MODEL(".\\Resources\\Models\\sphere.obj"); ///< Convex mesh to drape over
+    const D3DXVECTOR3 DRAPE_HULL_SCALE(1.0f, 1.0f, 1.0f);         ///< Scale of the convex mesh to drape over
+    const int PENETRATION_SAMPLES = 32;  ///< Particle positions along each side of the box top
+    const int PENETRATION_DEPTHS = 4;    ///< Depths into the box top the particle is placed at
+
+    int allocations = 0;  ///< Heap allocations counted while the allocation hook is set
+
+    /**
+    * Debug heap hook counting each allocation made while it is set
+    */
+    int CountAllocations(int type, void*, size_t, int, long, const unsigned char*, int)
+    {
+        allocations += type == _HOOK_ALLOC ? 1 : 0;
+        return TRUE;
+    }
+}
+
+Benchmark::Benchmark(EnginePtr engine,
+                     std::shared_ptr<Cloth> cloth,
+                     std::shared_ptr<CollisionSolver> solver) :
+    m_engine(engine),
+    m_cloth(cloth),
+    m_solver(solver)
+{
+}
+
+double Benchmark::Time(int repeats, WorkFn work) const
+{
+    for(int i = 0; i < WARMUP_REPEATS; ++i)
+    {
+        work();
+    }
+
+    StopWatch watch;
+    for(int i = 0; i < repeats; ++i)
+    {
+        work();
+    }
+    return watch.GetElapsedMilliseconds() / repeats;
+}
+
+void Benchmark::Report(const std::string& id, const std::string& result)
+{
+    m_engine->diagnostic()->UpdateText(Diagnostic::TEXT,
+        id, Diagnostic::YELLOW, result);
+
+    OutputDebugString((id + ": " + result + "\n").c_str());
+}
+
+void Benchmark::SelfCollision()
+{
+    const double savedRows = m_cloth->GetVertexRows();
+
+    // Time per particle stays flat if the cost grows linearly with the particles
+    for(int rows : CLOTH_ROWS)
+    {
+        m_cloth->SetVertexRows(rows);
+        const double particles = rows * rows;
+        const double milliseconds = Time(TIMED_REPEATS,
+            [this](){ m_solver->SolveSelfCollision(); });
+
+        Report("SelfCollision" + StringCast(rows), StringCast(milliseconds) +
+            "ms " + StringCast(milliseconds * 1000000.0 / particles) + "ns/particle");
+    }
+
+    m_cloth->SetVertexRows(savedRows);
+    m_cloth->Reset();
+}
+
+void Benchmark::SpringKernels()
+{
+    const double savedRows = m_cloth->GetVertexRows();
+    SpringKernel& kernel = m_cloth->GetSpringKernel();
+    const SpringKernel::Path savedPath = kernel.GetPath();
+
+    for(int rows : CLOTH_ROWS)
+    {
+        m_cloth->SetVertexRows(rows);
+        const double springs = m_cloth->GetSpringCount() * m_cloth->GetIterations();
+
+        for(int path = 0; path < SpringKernel::MAX_PATHS; ++path)
+        {
+            const SpringKernel::Path kernelPath = static_cast<SpringKernel::Path>(path);
+            const std::string id("SpringKernel" + StringCast(rows) + 
+                SpringKernel::GetPathName(kernelPath));
+
+            if(!kernel.IsSupported(kernelPath))
+            {
+                Report(id, "unsupported");
+                continue;
+            }
+
+            kernel.SetPath(kernelPath);
+            const double milliseconds = Time(TIMED_REPEATS,
+                [this](){ m_cloth->SolveSprings(); });
+
+            Report(id, StringCast(milliseconds) + "ms " + 
+                StringCast(milliseconds * 1000000.0 / springs) + "ns/spring");
+        }
+    }
+
+    kernel.SetPath(savedPath);
+    m_cloth->SetVertexRows(savedRows);
+    m_cloth->Reset();
+}
+
+void Benchmark::DisturbCloth(std::vector<D3DXVECTOR3>& positions)
+{
+    const ParticleStore& particles = m_cloth->GetParticleStore();
+    const float amount = static_cast<float>(m_cloth->GetSpacing()) * DISTURBANCE;
+
+    // Cheap hash of the index so each run sees the same disturbance
+    auto offset = [amount](int index, int component) -> float
+    {
+        unsigned int hash = static_cast<unsigned int>(index * 3 + component) * 2654435761u;
+        hash ^= hash >> 16;
+        return ((hash & 0xFFFF) / 32767.5f - 1.0f) * amount;
+    };
+
+    positions.resize(particles.Size());
+    for(int i = 0; i < particles.Size(); ++i)
+    {
+        positions[i] = particles.GetPosition(i) + 
+            D3DXVECTOR3(offset(i, 0), offset(i, 1), offset(i, 2));
+    }
+}
+
+void Benchmark::SetClothPositions(const std::vector<D3DXVECTOR3>& positions)
+{
+    ParticleStore& particles = m_cloth->GetParticleStore();
+    for(unsigned int i = 0; i < positions.size(); ++i)
+    {
+        particles.SetPosition(i, positions[i]);
+    }
+}
+
+void Benchmark::SolverConvergence()
+{
+    const double savedRows = m_cloth->GetVertexRows();
+    const double savedIterations = m_cloth->GetIterations();
+    const Cloth::Solver savedSolver = m_cloth->GetSolver();
+    std::vector<D3DXVECTOR3> disturbed;
+
+    for(int rows : CONVERGENCE_ROWS)
+    {
+        m_cloth->SetVertexRows(rows);
+        DisturbCloth(disturbed);
+        SetClothPositions(disturbed);
+        const double initialResidual = m_cloth->GetSpringResidual();
+
+        for(int solver = 0; solver < Cloth::MAX_SOLVERS; ++solver)
+        {
+            const Cloth::Solver clothSolver = static_cast<Cloth::Solver>(solver);
+            m_cloth->SetSolver(clothSolver);
+
+            for(int iterations : CONVERGENCE_ITERATIONS)
+            {
+                m_cloth->SetIterations(iterations);
+
+                // Each repeat starts from the same disturbance; only the solve is timed
+                double milliseconds = 0.0;
+                StopWatch watch;
+                for(int i = 0; i < TIMED_REPEATS; ++i)
+                {
+                    SetClothPositions(disturbed);
+                    watch.Start();
+                    m_cloth->SolveSprings();
+                    milliseconds += watch.GetElapsedMilliseconds();
+                }
+                milliseconds /= TIMED_REPEATS;
+
+                // Orders of magnitude the stretch is reduced by per millisecond
+                const double residual = m_cloth->GetSpringResidual();
+                const double reduction = log10(initialResidual / residual);
+
+                Report("Convergence" + StringCast(rows) + Cloth::GetSolverName(clothSolver) + 
+                    StringCast(iterations), StringCast(milliseconds) + "ms residual " + 
+                    StringCast(residual) + " " + StringCast(reduction / milliseconds) + "/ms");
+            }
+        }
+    }
+
+    m_cloth->SetSolver(savedSolver);
+    m_cloth->SetIterations(savedIterations);
+    m_cloth->SetVertexRows(savedRows);
+    m_cloth->Reset();
+}
+
+double Benchmark::HangCloth()
+{
+    m_cloth->Reset();
+
+    StopWatch watch;
+    for(int i = 0; i < HANG_TICKS; ++i)
+    {
+        m_cloth->PreCollisionUpdate(HANG_DELTATIME);
+    }
+    return watch.GetElapsedMilliseconds();
+}
+
+void Benchmark::ImplicitIntegration()
+{
+    const double savedRows = m_cloth->GetVertexRows();
+    const double savedIterations = m_cloth->GetIterations();
+    const Cloth::Solver savedSolver = m_cloth->GetSolver();
+    const Cloth::Integrator savedIntegrator = m_cloth->GetIntegrator();
+    const bool savedSimulation = m_cloth->IsSimulating();
+
+    m_cloth->SetSimulation(true);
+    m_cloth->SetSolver(Cloth::GAUSS_SEIDEL);
+
+    for(int rows : IMPLICIT_ROWS)
+    {
+        m_cloth->SetVertexRows(rows);
+
+        auto& particles = m_cloth->GetParticles();
+        Particle& first = *particles[0];
+        Particle& last = *particles[rows-1];
+        const bool firstPinned = first.IsPinned();
+        const bool lastPinned = last.IsPinned();
+        first.PinParticle(true);
+        last.PinParticle(true);
+
+        m_cloth->SetIntegrator(Cloth::IMPLICIT_EULER);
+        const double implicitTime = HangCloth();
+        const double implicitResidual = m_cloth->GetSpringResidual();
+
+        Report("Implicit" + StringCast(rows), StringCast(implicitTime) + 
+            "ms residual " + StringCast(implicitResidual));
+
+        // Double the iterations until the explicit stretch is no worse than implicit
+        m_cloth->SetIntegrator(Cloth::VERLET);
+        double explicitTime = 0.0;
+        double explicitResidual = 0.0;
+        int iterations = 1;
+        for(; iterations <= MAX_EXPLICIT_ITERATIONS; iterations *= 2)
+        {
+            m_cloth->SetIterations(iterations);
+            explicitTime = HangCloth();
+            explicitResidual = m_cloth->GetSpringResidual();
+            if(explicitResidual <= implicitResidual)
+            {
+                break;
+            }
+        }
+
+        Report("Explicit" + StringCast(rows), StringCast(explicitTime) + 
+            "ms residual " + StringCast(explicitResidual) + (iterations > MAX_EXPLICIT_ITERATIONS ?
+            " not reached" : " at " + StringCast(iterations) + " iterations"));
+
+        first.PinParticle(firstPinned);
+        last.PinParticle(lastPinned);
+    }
+
+    m_cloth->SetSimulation(savedSimulation);
+    m_cloth->SetIntegrator(savedIntegrator);
+    m_cloth->SetSolver(savedSolver);
+    m_cloth->SetIterations(savedIterations);
+    m_cloth->SetVertexRows(savedRows);
+    m_cloth->Reset();
+}
+
+void Benchmark::ChebyshevAcceleration()
+{
+    const double savedRows = m_cloth->GetVertexRows();
+    const double savedIterations = m_cloth->GetIterations();
+    const Cloth::Solver savedSolver = m_cloth->GetSolver();
+    const bool savedAcceleration = m_cloth->IsAccelerated();
+    std::vector<D3DXVECTOR3> disturbed;
+
+    m_cloth->SetSolver(Cloth::JACOBI);
+
+    auto timeSolve = [&]() -> double
+    {
+        SetClothPositions(disturbed);
+        StopWatch watch;
+        m_cloth->SolveSprings();
+        return watch.GetElapsedMilliseconds();
+    };
+
+    for(int rows : CHEBYSHEV_ROWS)
+    {
+        m_cloth->SetVertexRows(rows);
+        DisturbCloth(disturbed);
+
+        m_cloth->SetAcceleration(false);
+        m_cloth->SetIterations(REFERENCE_ITERATIONS);
+        const double plainTime = timeSolve();
+        const double target = m_cloth->GetSpringResidual();
+
+        // Estimate the spectral radius first so it is not part of the timing
+        m_cloth->SetAcceleration(true);
+        m_cloth->SetIterations(1);
+        timeSolve();
+
+        double acceleratedTime = 0.0;
+        int iterations = 1;
+        for(; iterations <= REFERENCE_ITERATIONS; ++iterations)
+        {
+            m_cloth->SetIterations(iterations);
+            acceleratedTime = timeSolve();
+            if(m_cloth->GetSpringResidual() <= target)
+            {
+                break;
+            }
+        }
+
+        const float radius = m_cloth->GetAccelerator().GetSpectralRadius();
+        Report("Chebyshev" + StringCast(rows), (iterations > REFERENCE_ITERATIONS ? 
+            std::string("not reached") : StringCast(iterations) + " iterations " + 
+            StringCast(acceleratedTime) + "ms") + " against " + StringCast(REFERENCE_ITERATIONS) + 
+            " iterations " + StringCast(plainTime) + "ms radius " + StringCast(radius));
+    }
+
+    m_cloth->SetAcceleration(savedAcceleration);
+    m_cloth->SetSolver(savedSolver);
+    m_cloth->SetIterations(savedIterations);
+    m_cloth->SetVertexRows(savedRows);
+    m_cloth->Reset();
+}
+
+void Benchmark::RebuildLatency()
+{
+    const double savedRows = m_cloth->GetVertexRows();
+    const double savedSpacing = m_cloth->GetSpacing();
+
+    // Alternating between two sizes times both growing and shrinking the cloth
+    for(int rows : CLOTH_ROWS)
+    {
+        m_cloth->SetVertexRows(rows);
+
+        bool grow = true;
+        const double rowsTime = Time(REBUILD_REPEATS, [&]()
+        {
+            m_cloth->SetVertexRows(grow ? rows + REBUILD_ROW_CHANGE : rows);
+            grow = !grow;
+        });
+
+        m_cloth->SetVertexRows(rows);
+
+        bool enlarge = true;
+        const double spacingTime = Time(REBUILD_REPEATS, [&]()
+        {
+            m_cloth->SetSpacing(enlarge ? savedSpacing * REBUILD_SPACING_SCALE : savedSpacing);
+            enlarge = !enlarge;
+        });
+
+        m_cloth->SetSpacing(savedSpacing);
+
+        Report("Rebuild" + StringCast(rows), "rows " + StringCast(rowsTime) + 
+            "ms spacing " + StringCast(spacingTime) + "ms");
+    }
+
+    m_cloth->SetVertexRows(savedRows);
+    m_cloth->Reset();
+}
+
+void Benchmark::ParticleLayout()
+{
+    const double savedRows = m_cloth->GetVertexRows();
+    const GridLayout::Order savedLayout = m_cloth->GetLayout();
+    std::vector<D3DXVECTOR3> disturbed;
+
+    for(int rows : LAYOUT_ROWS)
+    {
+        m_cloth->SetVertexRows(rows);
+        for(int i = 0; i < GridLayout::MAX_ORDERS; ++i)
+        {
+            const GridLayout::Order layout = static_cast<GridLayout::Order>(i);
+            m_cloth->SetLayout(layout);
+            DisturbCloth(disturbed);
+
+            const double springTime = Time(TIMED_REPEATS, [&]()
+            {
+                SetClothPositions(disturbed);
+                m_cloth->SolveSprings();
+            });
+
+            const double collisionTime = Time(TIMED_REPEATS,
+                [this](){ m_solver->SolveSelfCollision(); });
+
+            const double vertexTime = Time(TIMED_REPEATS,
+                [this](){ m_cloth->PostCollisionUpdate(); });
+
+            Report("Layout" + StringCast(rows) + GridLayout::GetOrderName(layout),
+                "springs " + StringCast(springTime) + "ms collision " + 
+                StringCast(collisionTime) + "ms vertices " + StringCast(vertexTime) + "ms");
+        }
+    }
+
+    m_cloth->SetLayout(savedLayout);
+    m_cloth->SetVertexRows(savedRows);
+    m_cloth->Reset();
+}
+
+void Benchmark::LongRangeAttachments()
+{
+    const double savedRows = m_cloth->GetVertexRows();
+    const double savedIterations = m_cloth->GetIterations();
+    const Cloth::Solver savedSolver = m_cloth->GetSolver();
+    const bool savedAttachments = m_cloth->IsAttaching();
+    const bool savedSimulation = m_cloth->IsSimulating();
+
+    m_cloth->SetSimulation(true);
+    m_cloth->SetSolver(Cloth::GAUSS_SEIDEL);
+
+    for(int rows : ATTACHMENT_ROWS)
+    {
+        m_cloth->SetVertexRows(rows);
+
+        auto& particles = m_cloth->GetParticles();
+        Particle& first = *particles[0];
+        Particle& last = *particles[rows-1];
+        const bool firstPinned = first.IsPinned();
+        const bool lastPinned = last.IsPinned();
+        first.PinParticle(true);
+        last.PinParticle(true);
+
+        m_cloth->SetAttachments(true);
+        m_cloth->SetIterations(ATTACHMENT_ITERATIONS);
+        const double attachedTime = HangCloth();
+        const double attachedResidual = m_cloth->GetSpringResidual();
+
+        Report("Attached" + StringCast(rows), StringCast(attachedTime) + "ms residual " + 
+            StringCast(attachedResidual) + " at " + StringCast(ATTACHMENT_ITERATIONS) + " iterations");
+
+        // Double the iterations until the stretch is no worse than with attachments
+        m_cloth->SetAttachments(false);
+        double unattachedTime = 0.0;
+        double unattachedResidual = 0.0;
+        int iterations = 1;
+        for(; iterations <= MAX_EXPLICIT_ITERATIONS; iterations *= 2)
+        {
+            m_cloth->SetIterations(iterations);
+            unattachedTime = HangCloth();
+            unattachedResidual = m_cloth->GetSpringResidual();
+            if(unattachedResidual <= attachedResidual)
+            {
+                break;
+            }
+        }
+
+        Report("Unattached" + StringCast(rows), StringCast(unattachedTime) + 
+            "ms residual " + StringCast(unattachedResidual) + (iterations > MAX_EXPLICIT_ITERATIONS ?
+            " not reached" : " at " + StringCast(iterations) + " iterations"));
+
+        first.PinParticle(firstPinned);
+        last.PinParticle(lastPinned);
+    }
+
+    m_cloth->SetSimulation(savedSimulation);
+    m_cloth->SetAttachments(savedAttachments);
+    m_cloth->SetSolver(savedSolver);
+    m_cloth->SetIterations(savedIterations);
+    m_cloth->SetVertexRows(savedRows);
+    m_cloth->Reset();
+}
+
+void Benchmark::StrainLimiting()
+{
+    const double savedRows = m_cloth->GetVertexRows();
+    const double savedIterations = m_cloth->GetIterations();
+    const Cloth::Solver savedSolver = m_cloth->GetSolver();
+    const bool savedAttachments = m_cloth->IsAttaching();
+    const bool savedLimiting = m_cloth->IsLimitingStrain();
+    const bool savedSimulation = m_cloth->IsSimulating();
+
+    // Attachments would also bound the stretch and hide the effect of the limits
+    m_cloth->SetSimulation(true);
+    m_cloth->SetSolver(Cloth::GAUSS_SEIDEL);
+    m_cloth->SetAttachments(false);
+
+    for(int rows : STRAIN_ROWS)
+    {
+        m_cloth->SetVertexRows(rows);
+
+        auto& particles = m_cloth->GetParticles();
+        Particle& first = *particles[0];
+        Particle& last = *particles[rows-1];
+        const bool firstPinned = first.IsPinned();
+        const bool lastPinned = last.IsPinned();
+        first.PinParticle(true);
+        last.PinParticle(true);
+
+        for(int limitedIterations : STRAIN_ITERATIONS)
+        {
+            m_cloth->SetStrainLimiting(true);
+            m_cloth->SetIterations(limitedIterations);
+            const double limitedTime = HangCloth();
+            const double limitedStrain = m_cloth->GetMaxStrain();
+
+            // Add iterations until the strain is no worse than with limiting
+            m_cloth->SetStrainLimiting(false);
+            double unlimitedTime = 0.0;
+            int iterations = limitedIterations;
+            for(; iterations <= MAX_EXPLICIT_ITERATIONS; ++iterations)
+            {
+                m_cloth->SetIterations(iterations);
+                unlimitedTime = HangCloth();
+                if(m_cloth->GetMaxStrain() <= limitedStrain)
+                {
+                    break;
+                }
+            }
+
+            Report("StrainLimiting" + StringCast(rows) + "x" + StringCast(limitedIterations),
+                "strain " + StringCast(limitedStrain) + " " + StringCast(limitedTime) + "ms against " + 
+                (iterations > MAX_EXPLICIT_ITERATIONS ? std::string("not reached") : 
+                StringCast(iterations) + " iterations " + StringCast(unlimitedTime) + "ms"));
+        }
+
+        first.PinParticle(firstPinned);
+        last.PinParticle(lastPinned);
+    }
+
+    m_cloth->SetSimulation(savedSimulation);
+    m_cloth->SetStrainLimiting(savedLimiting);
+    m_cloth->SetAttachments(savedAttachments);
+    m_cloth->SetSolver(savedSolver);
+    m_cloth->SetIterations(savedIterations);
+    m_cloth->SetVertexRows(savedRows);
+    m_cloth->Reset();
+}
+
+void Benchmark::MembraneModel()
+{
+    const double savedRows = m_cloth->GetVertexRows();
+    const Cloth::Solver savedSolver = m_cloth->GetSolver();
+    const bool savedMembrane = m_cloth->IsSolvingMembrane();
+
+    m_cloth->SetSolver(Cloth::GAUSS_SEIDEL);
+
+    for(int rows : CLOTH_ROWS)
+    {
+        m_cloth->SetVertexRows(rows);
+        const double particles = rows * rows;
+
+        m_cloth->SetMembrane(false);
+        const double springTime = Time(TIMED_REPEATS,
+            [this](){ m_cloth->SolveSprings(); });
+
+        Report("Springs" + StringCast(rows), StringCast(springTime) + "ms " + 
+            StringCast(springTime * 1000000.0 / particles) + "ns/particle " +
+            StringCast(m_cloth->GetSpringCount()) + " springs");
+
+        m_cloth->SetMembrane(true);
+        const double membraneTime = Time(TIMED_REPEATS,
+            [this](){ m_cloth->SolveSprings(); });
+
+        Report("Membrane" + StringCast(rows), StringCast(membraneTime) + "ms " + 
+            StringCast(membraneTime * 1000000.0 / particles) + "ns/particle " +
+            StringCast(m_cloth->GetMembraneTriangleCount()) + " triangles");
+    }
+
+    m_cloth->SetMembrane(savedMembrane);
+    m_cloth->SetSolver(savedSolver);
+    m_cloth->SetVertexRows(savedRows);
+    m_cloth->Reset();
+}
+
+double Benchmark::DrapeCloth(const CollisionMesh& object)
+{
+    m_cloth->Reset();
+    auto& particles = m_cloth->GetParticles();
+
+    // Every particle is tested each tick so the time includes the misses
+    double milliseconds = 0.0;
+    for(int i = 0; i < HANG_TICKS; ++i)
+    {
+        m_cloth->PreCollisionUpdate(HANG_DELTATIME);
+
+        StopWatch watch;
+        for(const auto& particle : particles)
+        {
+            m_solver->SolveObjectCollision(particle->GetCollisionMesh(), object);
+        }
+        milliseconds += watch.GetElapsedMilliseconds();
+
+        m_solver->RetireContacts();
+        m_cloth->PostCollisionUpdate();
+    }
+    return milliseconds;
+}
+
+void Benchmark::DrapePrimitives()
+{
+    const double savedRows = m_cloth->GetVertexRows();
+    const bool savedSimulation = m_cloth->IsSimulating();
+    const bool savedAnalytic = m_solver->IsUsingAnalyticPrimitives();
+
+    m_cloth->SetSimulation(true);
+
+    const ParticleStore& store = m_cloth->GetParticleStore();
+    auto countContacts = [&store]() -> int
+    {
+        int contacts = 0;
+        for(int i = 0; i < store.Size(); ++i)
+        {
+            contacts += store.HasFlag(i, ParticleStore::HULL_CONTACT) ? 1 : 0;
+        }
+        return contacts;
+    };
+
+    const Geometry::Shape shapes[] = { Geometry::BOX, Geometry::CYLINDER };
+    for(Geometry::Shape shape : shapes)
+    {
+        // The object has no parent so is centered at the origin below the cloth
+        CollisionMesh object(m_engine);
+        const bool box = shape == Geometry::BOX;
+        object.Initialise(true, shape, box ? DRAPE_BOX_SCALE : 
+            DRAPE_CYLINDER_SCALE, box ? 0 : DRAPE_CYLINDER_DIVISIONS);
+
+        for(int rows : DRAPE_ROWS)
+        {
+            m_cloth->SetVertexRows(rows);
+            const std::string id((box ? "DrapeBox" : "DrapeCylinder") + StringCast(rows));
+
+            std::string result;
+            for(int analytic = 0; analytic < 2; ++analytic)
+            {
+                m_solver->SetAnalyticPrimitives(analytic != 0);
+                const double milliseconds = DrapeCloth(object);
+                result += (analytic ? " analytic " : "GJK ") + StringCast(milliseconds) + 
+                    "ms " + StringCast(countContacts()) + " contacts";
+            }
+            Report(id, result);
+        }
+    }
+
+    // A loaded convex mesh has no exact test so is always solved with GJK and EPA
+    std::shared_ptr<Geometry> geometry(new Geometry(m_engine->device(), DRAPE_HULL_MODEL,
+        m_engine->getShader(ShaderManager::BOUNDS_SHADER), true));
+
+    CollisionMesh hull(m_engine);
+    hull.Initialise(geometry, DRAPE_HULL_SCALE, DRAPE_HULL_SCALE);
+
+    for(int rows : DRAPE_ROWS)
+    {
+        m_cloth->SetVertexRows(rows);
+        const double milliseconds = DrapeCloth(hull);
+        Report("DrapeHull" + StringCast(rows), "GJK " + StringCast(milliseconds) + "ms " + 
+            StringCast(countContacts()) + " contacts " + StringCast(hull.GetVertices().size()) + 
+            " vertices");
+    }
+
+    m_solver->SetAnalyticPrimitives(savedAnalytic);
+    m_cloth->SetSimulation(savedSimulation);
+    m_cloth->SetVertexRows(savedRows);
+    m_cloth->Reset();
+}
+
+void Benchmark::HullPenetration()
+{
+    // The first particle is placed through the top of a box so nearly every
+    // query reaches EPA; resetting the cloth afterwards moves it back
+    CollisionMesh hull(m_engine);
+    hull.Initialise(true, Geometry::BOX, DRAPE_BOX_SCALE);
+
+    m_cloth->Reset();
+    CollisionMesh& particle = m_cloth->GetParticles()[0]->GetCollisionMesh();
+    const float radius = particle.GetRadius();
+    const float extent = (DRAPE_BOX_SCALE.x * 0.5f) + radius;
+    const float top = (DRAPE_BOX_SCALE.y * 0.5f) + radius;
+
+    std::vector<D3DXVECTOR3> positions;
+    positions.reserve(PENETRATION_SAMPLES * PENETRATION_SAMPLES);
+    for(int x = 0; x < PENETRATION_SAMPLES; ++x)
+    {
+        for(int z = 0; z < PENETRATION_SAMPLES; ++z)
+        {
+            const int depth = 1 + ((x + z) % PENETRATION_DEPTHS);
+            positions.emplace_back(
+                extent * ((2.0f * x / (PENETRATION_SAMPLES - 1)) - 1.0f),
+                top - (radius * depth / PENETRATION_DEPTHS),
+                extent * ((2.0f * z / (PENETRATION_SAMPLES - 1)) - 1.0f));
+        }
+    }
+
+    int collisions = 0;
+    auto query = [&]()
+    {
+        collisions = 0;
+        D3DXVECTOR3 penetration;
+        for(const D3DXVECTOR3& position : positions)
+        {
+            particle.SetPosition(position);
+            collisions += m_solver->GetHullPenetration(particle, hull, penetration) ? 1 : 0;
+        }
+    };
+
+    Time(WARMUP_REPEATS, query);
+    const double milliseconds = Time(TIMED_REPEATS, query);
+    const double queries = static_cast<double>(positions.size());
+
+    // Allocations can only be counted through the debug heap
+#ifdef _DEBUG
+    allocations = 0;
+    _CRT_ALLOC_HOOK previousHook = _CrtSetAllocHook(CountAllocations);
+    query();
+    _CrtSetAllocHook(previousHook);
+    const std::string allocated(StringCast(allocations / queries));
+#else
+    const std::string allocated("(debug only)");
+#endif
+
+    Report("HullPenetration", StringCast(milliseconds * 1000.0 / queries) + "us " + 
+        allocated + " allocations per query " + StringCast(collisions) + " of " + 
+        StringCast(positions.size()) + " colliding");
+
+    m_cloth->Reset();
+}
\ No newline at end of file
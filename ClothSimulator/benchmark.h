@@ -0,0 +1,154 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - benchmark.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+#include "callbacks.h"
+
+class Cloth;
+class CollisionSolver;
+class CollisionMesh;
+
+/**
+* Runs timed performance scenarios on the simulation
+* Results are shown through the text diagnostics and the debug output
+*/
+class Benchmark
+{
+public:
+
+    typedef std::function<void(void)> WorkFn;
+
+    /**
+    * Constructor
+    * @param engine Callbacks from the rendering engine
+    * @param cloth The cloth to benchmark
+    * @param solver The collision solver for the cloth
+    */
+    Benchmark(EnginePtr engine,
+        std::shared_ptr<Cloth> cloth,
+        std::shared_ptr<CollisionSolver> solver);
+
+    /**
+    * Times the cloth self collision for increasing cloth sizes
+    */
+    void SelfCollision();
+
+    /**
+    * Times the spring solve with each supported kernel path for increasing cloth sizes
+    */
+    void SpringKernels();
+
+    /**
+    * Measures how far each spring solver reduces the stretch of a disturbed
+    * cloth for increasing iterations and the time taken to do so
+    */
+    void SolverConvergence();
+
+    /**
+    * Times hanging the cloth with implicit integration then finds the
+    * Gauss-Seidel iterations and time needed to reach the same stretch
+    */
+    void ImplicitIntegration();
+
+    /**
+    * Finds the iterations and time the Jacobi solver needs with Chebyshev
+    * acceleration to reach the stretch of a fixed amount of plain iterations
+    */
+    void ChebyshevAcceleration();
+
+    /**
+    * Times changing the rows and the spacing of the cloth for increasing cloth sizes
+    */
+    void RebuildLatency();
+
+    /**
+    * Times the spring solve, self collision and vertex update of large
+    * cloths with the particles stored in each of the grid layouts
+    */
+    void ParticleLayout();
+
+    /**
+    * Times hanging the cloth at a few iterations with long range attachments
+    * then finds the iterations and time needed to reach the same stretch without
+    */
+    void LongRangeAttachments();
+
+    /**
+    * Finds the maximum strain of the hanging cloth at a few iterations with strain
+    * limiting then the iterations and time needed to reach the same strain without
+    */
+    void StrainLimiting();
+
+    /**
+    * Times a spring solve with the stretch and shear springs against 
+    * the same solve with the finite element membrane in their place
+    */
+    void MembraneModel();
+
+    /**
+    * Drapes the cloth over a box and a cylinder and times the particle 
+    * collisions against each when solved exactly and with GJK and EPA,
+    * then over a loaded convex mesh solved with GJK and EPA
+    */
+    void DrapePrimitives();
+
+    /**
+    * Times GJK and EPA queries of a particle through the top of a box
+    * and counts the heap allocations each makes in debug builds
+    */
+    void HullPenetration();
+
+private:
+
+    /**
+    * Prevent copying
+    */
+    Benchmark(const Benchmark&) = delete;
+    Benchmark& operator=(const Benchmark&) = delete;
+
+    /**
+    * Times the average cost of the given work
+    * @param repeats The amount of times to repeat the work
+    * @param work The work to time
+    * @return the average time for the work in milliseconds
+    */
+    double Time(int repeats, WorkFn work) const;
+
+    /**
+    * Moves each particle of the cloth by a repeatable pseudo-random offset
+    * @param positions Filled with the disturbed positions
+    */
+    void DisturbCloth(std::vector<D3DXVECTOR3>& positions);
+
+    /**
+    * Sets the positions of all cloth particles
+    * @param positions The positions to set
+    */
+    void SetClothPositions(const std::vector<D3DXVECTOR3>& positions);
+
+    /**
+    * Resets the cloth then simulates it hanging from two corners
+    * @return the time taken in milliseconds
+    */
+    double HangCloth();
+
+    /**
+    * Drops the cloth from its initial position onto an object
+    * @param object The collision mesh to drape the cloth over
+    * @return the milliseconds spent solving the particles against the object
+    */
+    double DrapeCloth(const CollisionMesh& object);
+
+    /**
+    * Outputs a result for the benchmark
+    * @param id The unique id of the result
+    * @param result The result to display
+    */
+    void Report(const std::string& id, const std::string& result);
+
+    EnginePtr m_engine;                          ///< Callbacks for the rendering engine
+    std::shared_ptr<Cloth> m_cloth;              ///< Cloth to benchmark
+    std::shared_ptr<CollisionSolver> m_solver;   ///< Collision solver for the cloth
+};
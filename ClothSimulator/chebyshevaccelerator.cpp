@@ -0,0 +1,119 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - chebyshevaccelerator.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "chebyshevaccelerator.h"
+#include "particlestore.h"
+
+namespace
+{
+    const float SPECTRAL_RADIUS = 0.95f;      ///< Initial spectral radius of the solver iteration
+    const float MAX_SPECTRAL_RADIUS = 0.99f;  ///< Largest radius allowed before extrapolation diverges
+    const int WARMUP_ITERATIONS = 2;          ///< Initial iterations to run unaccelerated
+    const int ESTIMATE_ITERATIONS = 20;       ///< Unaccelerated iterations used to estimate the radius
+
+    /**
+    * @return the distance between two sets of positions
+    */
+    float GetChange(const ParticleStore::VectorArray& positions, 
+                    const ChebyshevAccelerator::VectorArray& previous)
+    {
+        float change = 0.0f;
+        for(unsigned int i = 0; i < positions.size(); ++i)
+        {
+            const D3DXVECTOR3 difference = positions[i] - previous[i];
+            change += D3DXVec3LengthSq(&difference);
+        }
+        return std::sqrt(change);
+    }
+}
+
+ChebyshevAccelerator::ChebyshevAccelerator() :
+    m_spectralRadius(SPECTRAL_RADIUS),
+    m_warmupIterations(WARMUP_ITERATIONS),
+    m_autoEstimate(true),
+    m_iteration(0),
+    m_omega(1.0f)
+{
+}
+
+void ChebyshevAccelerator::SetSpectralRadius(float radius)
+{
+    m_spectralRadius = max(0.0f, min(radius, MAX_SPECTRAL_RADIUS));
+}
+
+void ChebyshevAccelerator::SetWarmupIterations(int iterations)
+{
+    m_warmupIterations = max(iterations, 1);
+}
+
+bool ChebyshevAccelerator::Estimate(ParticleStore& particles, const IterateFn& iterate)
+{
+    const ParticleStore::VectorArray& positions = particles.GetPositions();
+    m_previous.assign(positions.begin(), positions.end());
+    m_current.assign(positions.begin(), positions.end());
+
+    // The early iterations remove fast error; the ratio approaches the 
+    // spectral radius as the slowest error comes to dominate the change
+    float previousChange = 0.0f;
+    float ratio = 0.0f;
+    for(int i = 0; i < ESTIMATE_ITERATIONS; ++i)
+    {
+        iterate();
+        const float change = GetChange(positions, m_current);
+        if(change == 0.0f)
+        {
+            break;
+        }
+
+        ratio = previousChange > 0.0f ? change / previousChange : ratio;
+        previousChange = change;
+        m_current.assign(positions.begin(), positions.end());
+    }
+
+    for(int i = 0; i < particles.Size(); ++i)
+    {
+        particles.SetPosition(i, m_previous[i]);
+    }
+
+    if(ratio == 0.0f)
+    {
+        return false;
+    }
+
+    SetSpectralRadius(ratio);
+    return true;
+}
+
+void ChebyshevAccelerator::Begin(const ParticleStore& particles)
+{
+    const ParticleStore::VectorArray& positions = particles.GetPositions();
+    m_current.assign(positions.begin(), positions.end());
+    m_previous.assign(positions.begin(), positions.end());
+    m_iteration = 0;
+    m_omega = 1.0f;
+}
+
+void ChebyshevAccelerator::Accelerate(ParticleStore& particles)
+{
+    if(m_iteration >= m_warmupIterations)
+    {
+        const float radiusSqr = m_spectralRadius * m_spectralRadius;
+        m_omega = m_iteration == m_warmupIterations ?
+            2.0f / (2.0f - radiusSqr) : 4.0f / (4.0f - (radiusSqr * m_omega));
+
+        // Pinned particles never move so their extrapolation leaves them in place
+        const int count = particles.Size();
+        for(int i = 0; i < count; ++i)
+        {
+            const D3DXVECTOR3 extrapolated = m_previous[i] +
+                ((particles.GetPosition(i) - m_previous[i]) * m_omega);
+            particles.SetPosition(i, extrapolated);
+        }
+    }
+
+    m_previous.swap(m_current);
+    const ParticleStore::VectorArray& positions = particles.GetPositions();
+    m_current.assign(positions.begin(), positions.end());
+    ++m_iteration;
+}
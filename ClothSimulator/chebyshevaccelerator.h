@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - chebyshevaccelerator.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+#include "alignedallocator.h"
+#include <functional>
+
+class ParticleStore;
+
+/**
+* Extrapolates the particle positions over successive spring solver
+* iterations using the Chebyshev semi-iterative method
+* Reference from 'A Chebyshev Semi-Iterative Approach for Accelerating
+* Projective and Position-based Dynamics' by Huamin Wang
+*/
+class ChebyshevAccelerator
+{
+public:
+
+    typedef std::vector<D3DXVECTOR3, AlignedAllocator<D3DXVECTOR3>> VectorArray;
+    typedef std::function<void(void)> IterateFn;
+
+    /**
+    * Constructor
+    */
+    ChebyshevAccelerator();
+
+    /**
+    * Starts accelerating a new solve from the current positions
+    * @param particles The simulated state of all particles
+    */
+    void Begin(const ParticleStore& particles);
+
+    /**
+    * Extrapolates the positions after a solver iteration
+    * @param particles The simulated state of all particles
+    */
+    void Accelerate(ParticleStore& particles);
+
+    /**
+    * Estimates the spectral radius from how quickly the change made by each
+    * unaccelerated iteration shrinks. Positions are restored afterwards
+    * @param particles The simulated state of all particles
+    * @param iterate Runs one unaccelerated solver iteration
+    * @return whether there was error to estimate from
+    */
+    bool Estimate(ParticleStore& particles, const IterateFn& iterate);
+
+    /**
+    * @param radius The estimated spectral radius of the solver iteration
+    */
+    void SetSpectralRadius(float radius);
+
+    /**
+    * @return the spectral radius used to extrapolate the positions
+    */
+    float GetSpectralRadius() const { return m_spectralRadius; }
+
+    /**
+    * @param iterations The iterations to run unaccelerated at the start of each solve
+    */
+    void SetWarmupIterations(int iterations);
+
+    /**
+    * @return the iterations to run unaccelerated at the start of each solve
+    */
+    int GetWarmupIterations() const { return m_warmupIterations; }
+
+    /**
+    * @param estimate Whether the owner should estimate the spectral radius when the solver changes
+    */
+    void SetAutoEstimate(bool estimate) { m_autoEstimate = estimate; }
+
+    /**
+    * @return whether the owner should estimate the spectral radius when the solver changes
+    */
+    bool IsAutoEstimating() const { return m_autoEstimate; }
+
+private:
+
+    /**
+    * Prevent copying
+    */
+    ChebyshevAccelerator(const ChebyshevAccelerator&) = delete;
+    ChebyshevAccelerator& operator=(const ChebyshevAccelerator&) = delete;
+
+    float m_spectralRadius;     ///< Estimated spectral radius of the solver iteration
+    int m_warmupIterations;     ///< Iterations to run unaccelerated at the start of each solve
+    bool m_autoEstimate;        ///< Whether to estimate the spectral radius when the solver changes
+    int m_iteration;            ///< Iterations accelerated this solve
+    float m_omega;              ///< Current extrapolation weight
+    VectorArray m_current;      ///< Positions before the last iteration
+    VectorArray m_previous;     ///< Positions before the iteration prior to the last
+};
@@ -5,11 +5,26 @@
 #include "cloth.h"
 #include "input.h"
 #include "particle.h"
+#include "particlestore.h"
 #include "collisionmesh.h"
 #include "spring.h"
 #include "shader.h"
+#include "threadpool.h"
+#include "springkernel.h"
+#include "jacobisolver.h"
+#include "implicitsolver.h"
+#include "multigridsolver.h"
+#include "stencilsolver.h"
+#include "attachmentconstraints.h"
+#include "membranesolver.h"
+#include "chebyshevaccelerator.h"
+#include "clothtopology.h"
+#include "assimpmesh.h"
+#include "sleepregions.h"
+#include "gridlayout.h"
 #include <functional>
 #include <algorithm>
+#include <assert.h>
 
 namespace 
 {
@@ -31,8 +46,60 @@ namespace
     const float SPACING = 0.75f;           ///< Initial particle spacing for the cloth
     const int PARTICLE_SUBDIVISIONS = 8;   ///< Subdivisions for cloth particles
     const float SMOOTH_INCREASE = 0.01f;   ///< Increase amount when changing smoothing
+    const int MIN_PARALLEL_SPRINGS = 512;  ///< Smallest spring batch worth splitting across threads
+    const int BATCH_WINDOW = 32;           ///< Spring batches found in each pass with a bit for each
+    const int SUBSTEPS = 4;                ///< Initial XPBD substeps for the cloth
+    const float STRETCH_COMPLIANCE = 0.0f;    ///< Initial XPBD compliance for stretch springs
+    const float SHEAR_COMPLIANCE = 0.0001f;   ///< Initial XPBD compliance for shear springs
+    const float BEND_COMPLIANCE = 0.001f;     ///< Initial XPBD compliance for bend springs
+    const float MIN_STRETCH = 0.9f;           ///< Initial shortest spring length as a ratio of its rest
+    const float MAX_STRETCH = 1.1f;           ///< Initial longest spring length as a ratio of its rest
+    const float MEMBRANE_STIFFNESS = 1.0f;    ///< Fraction of the way each triangle moves to its rest shape
+    const float STRETCH_STIFFNESS = 200.0f;   ///< Initial implicit stiffness for stretch springs
+    const float SHEAR_STIFFNESS = 50.0f;      ///< Initial implicit stiffness for shear springs
+    const float BEND_STIFFNESS = 10.0f;       ///< Initial implicit stiffness for bend springs
+    const int MESH_SHRINK_FACTOR = 2;         ///< Times more faces than needed before the mesh is recreated
 
     const D3DXVECTOR3 STARTING_POSITION(0.5f, 8.0f, 0.0f); ///< Initial position for the cloth
+
+    /**
+    * Stably reorders items by a key using a counting sort
+    * @param order The items to reorder
+    * @param keys The key for each item
+    * @param keyCount One more than the largest key
+    */
+    void SortByKey(std::vector<int>& order, const int* keys, int keyCount)
+    {
+        std::vector<int> start(keyCount+1, 0);
+        for(int item : order)
+        {
+            ++start[keys[item]+1];
+        }
+        for(int i = 1; i <= keyCount; ++i)
+        {
+            start[i] += start[i-1];
+        }
+
+        std::vector<int> sorted(order.size());
+        for(int item : order)
+        {
+            sorted[start[keys[item]]++] = item;
+        }
+        order.swap(sorted);
+    }
+
+    /**
+    * Modify visual radius depending on the spacing
+    * Line chosen passes through (0.75, 0.15), (1.0, 0.18)
+    * @param spacing The spacing between particles
+    * @return the radius to render the particle markers
+    */
+    float GetVisualRadius(float spacing)
+    {
+        const float lineslope = 0.12f;
+        const float lineoffset = 0.06f;
+        return (lineslope * spacing) + lineoffset;
+    }
 }
 
 Cloth::Cloth(EnginePtr engine) :
@@ -54,11 +121,31 @@ Cloth::Cloth(EnginePtr engine) :
     m_gravity(0,-9.8f,0),
     m_generalSmoothing(0.85f),
     m_engine(engine),
+    m_store(new ParticleStore()),
+    m_allowSleeping(false),
+    m_threads(nullptr),
+    m_packedSprings(new PackedSprings()),
+    m_springKernel(new SpringKernel()),
+    m_uniformSpringWeights(false),
+    m_bendSprings(true),
+    m_attach(false),
+    m_solveMembrane(false),
+    m_limitStrain(false),
+    m_minStretch(MIN_STRETCH),
+    m_maxStretch(MAX_STRETCH),
+    m_solver(GAUSS_SEIDEL),
+    m_substeps(SUBSTEPS),
+    m_integrator(VERLET),
+    m_interpolation(1.0f),
+    m_accelerate(false),
+    m_estimateRadius(true),
     m_template(nullptr),
     m_mesh(nullptr),
     m_texture(nullptr),
     m_shader(nullptr),
-    m_diagnosticParticle(0)
+    m_diagnosticParticle(0),
+    m_layout(new GridLayout()),
+    m_layoutOrder(GridLayout::ROW_MAJOR)
 {
     D3DXVECTOR3 minimumScale(1.0f, 1.0f, 1.0f);
     D3DXVECTOR3 maximumScale(1.0f, 1.0f, 1.0f);
@@ -80,6 +167,26 @@ Cloth::Cloth(EnginePtr engine) :
     m_colors[PINNED] = engine->diagnostic()->GetColor(Diagnostic::RED);
     m_colors[SELECTED] = engine->diagnostic()->GetColor(Diagnostic::CYAN);
 
+    const int cores = static_cast<int>(std::thread::hardware_concurrency());
+    m_threads.reset(new ThreadPool(cores > 1 ? cores-1 : 0));
+    m_jacobi.reset(new JacobiSolver(*m_threads));
+    m_implicit.reset(new ImplicitSolver(*m_threads));
+    m_multigrid.reset(new MultigridSolver());
+    m_stencil.reset(new StencilSolver(*m_threads));
+    m_attachments.reset(new AttachmentConstraints(*m_threads));
+    m_membrane.reset(new MembraneSolver(*m_threads));
+    m_accelerator.reset(new ChebyshevAccelerator());
+    m_topology.reset(new ClothTopology());
+    m_sleep.reset(new SleepRegions());
+
+    m_compliance[Spring::STRETCH] = STRETCH_COMPLIANCE;
+    m_compliance[Spring::SHEAR] = SHEAR_COMPLIANCE;
+    m_compliance[Spring::BEND] = BEND_COMPLIANCE;
+
+    m_stiffness[Spring::STRETCH] = STRETCH_STIFFNESS;
+    m_stiffness[Spring::SHEAR] = SHEAR_STIFFNESS;
+    m_stiffness[Spring::BEND] = BEND_STIFFNESS;
+
     CreateCloth(ROWS, SPACING);
 }
 
@@ -92,57 +199,26 @@ void Cloth::CreateCloth(int rows, float spacing)
     m_spacing = spacing;
     m_particleLength = rows;
     m_particleCount = rows*rows;
+    m_quadVertices = m_subdivideCloth ? ((m_particleLength-1)*(m_particleLength-1)) : 0;
+    m_layout->Initialise(rows, m_layoutOrder);
 
-    // Remove any particles from octree no longer needed
-    int current = static_cast<int>(m_particles.size());
-    int difference = current - m_particleCount;
-    if(difference > 0)
-    {
-        for(int i = current-difference; i < current; ++i)
-        {
-            m_engine->octree()->RemoveObject(m_particles[i]->GetCollisionMesh());
-        }
-    }
-
-    // Create the particles
-    m_particles.resize(m_particleCount);
-    m_template->SetLocalScale(m_spacing/2.0f);
+    // Create the particle positions
+    std::vector<D3DXVECTOR3> positions(m_particleCount);
+    std::vector<D3DXVECTOR2> uvs(m_particleCount);
     const int mininum = -m_particleLength/2;
-    const int maximum = m_particleLength/2;
-
-    // Modify visual radius depending on the spacing
-    // Line chosen passes through (0.75, 0.15), (1.0, 0.18)
-    const float lineslope = 0.12f;
-    const float lineoffset = 0.06f;
-    const float visualRadius = (lineslope * m_spacing) + lineoffset;
 
     float UVu = 0;
     float UVv = 0;
-    int index = 0;
 
-    for(int x = mininum; x < maximum; ++x)
+    for(int x = 0; x < m_particleLength; ++x)
     {
-        for(int z = mininum; z < maximum; ++z, ++index)
+        for(int z = 0; z < m_particleLength; ++z)
         {
-            bool firstInitialisation = !m_particles[index].get();
-            D3DXVECTOR2 uvs(UVu, UVv);
-            D3DXVECTOR3 position = STARTING_POSITION;
-            position.x += x*m_spacing;
-            position.z += z*m_spacing;
-
-            if(firstInitialisation)
-            {
-                m_particles[index].reset(new Particle(m_engine));
-            }
-
-            m_particles[index]->Initialise(position, uvs, 
-                index, *m_template, visualRadius);
-
-            if(firstInitialisation)
-            {
-                m_engine->octree()->AddObject(m_particles[index]->GetCollisionMesh());
-            }
-
+            const int index = m_layout->GetParticle(x, z);
+            positions[index] = STARTING_POSITION;
+            positions[index].x += (x + mininum)*m_spacing;
+            positions[index].z += (z + mininum)*m_spacing;
+            uvs[index] = D3DXVECTOR2(UVu, UVv);
             UVu += 0.5;
         }
         UVu = 0;
@@ -150,61 +226,69 @@ void Cloth::CreateCloth(int rows, float spacing)
     }
 
     // Set a centered particle as the one to draw any diagnostics
-    m_diagnosticParticle = ((m_particleLength/2) * m_particleLength) + (m_particleLength/2);
-    auto& collision = m_particles[m_diagnosticParticle]->GetCollisionMesh();
-    collision.SetRenderSolverDiagnostics(true);
+    CreateParticles(positions, uvs, GetParticleIndex(
+        m_particleLength/2, m_particleLength/2));
 
-    // Create the vertices
-    m_quadVertices = m_subdivideCloth ? ((m_particleLength-1)*(m_particleLength-1)) : 0;
-    const int vertexCount = m_particleCount + m_quadVertices;
-    m_vertexData.resize(vertexCount);
-
-    // Create the indices
-    const int trianglesPerQuad = m_subdivideCloth ? 4 : 2;
-    int triangleNumber = ((m_particleLength-1)*(m_particleLength-1)) * trianglesPerQuad;
-    m_indexData.resize(triangleNumber * POINTS_IN_FACE);
+    // Create the indices; the topology always uses two triangles 
+    // per quad as subdividing only adds vertices for rendering
+    const int quadNumber = (m_particleLength-1)*(m_particleLength-1);
+    m_indexData.resize(m_subdivideCloth ? quadNumber * 4 * POINTS_IN_FACE : 0);
+    std::vector<DWORD> triangles;
+    triangles.reserve(quadNumber * 2 * POINTS_IN_FACE);
 
-    index = 0;
+    int index = 0;
     int quad = 0;
 
     for(int x = 0; x < m_particleLength-1; ++x)
     {
         for(int y = 0; y < m_particleLength-1; ++y)
         {
+            // Corners of the quad in the particle layout
+            const DWORD p1 = m_layout->GetParticle(x, y);
+            const DWORD p2 = m_layout->GetParticle(x, y+1);
+            const DWORD p3 = m_layout->GetParticle(x+1, y);
+            const DWORD p4 = m_layout->GetParticle(x+1, y+1);
+
+            triangles.push_back(p1);
+            triangles.push_back(p2);
+            triangles.push_back(p3);
+
+            triangles.push_back(p3);
+            triangles.push_back(p2);
+            triangles.push_back(p4);
+
             if(m_subdivideCloth)
             {
-                m_indexData[index]   = (x*m_particleLength)+y;
-                m_indexData[index+1] = (x*m_particleLength)+y+1;
+                m_indexData[index]   = p1;
+                m_indexData[index+1] = p2;
                 m_indexData[index+2] = m_particleCount + quad;
 
                 m_indexData[index+3] = m_particleCount + quad;
-                m_indexData[index+4] = (x*m_particleLength)+y+1;
-                m_indexData[index+5] = ((x+1)*m_particleLength)+y+1;
+                m_indexData[index+4] = p2;
+                m_indexData[index+5] = p4;
             
-                m_indexData[index+6] = ((x+1)*m_particleLength)+y;
-                m_indexData[index+7] = ((x+1)*m_particleLength)+y+1;
+                m_indexData[index+6] = p3;
+                m_indexData[index+7] = p4;
                 m_indexData[index+8] = m_particleCount + quad;
             
-                m_indexData[index+9] = (x*m_particleLength)+y;
+                m_indexData[index+9] = p1;
                 m_indexData[index+10] = m_particleCount + quad;
-                m_indexData[index+11] = ((x+1)*m_particleLength)+y;
-            }
-            else
-            {
-                m_indexData[index] = (x*m_particleLength)+y;
-                m_indexData[index+1] = (x*m_particleLength)+y+1;
-                m_indexData[index+2] = ((x+1)*m_particleLength)+y;
-
-                m_indexData[index+3] = ((x+1)*m_particleLength)+y;
-                m_indexData[index+4] = (x*m_particleLength)+y+1;
-                m_indexData[index+5] = ((x+1)*m_particleLength)+y+1;
+                m_indexData[index+11] = p3;
             }
 
             ++quad;
-            index += m_subdivideCloth ? 12 : 6;
+            index += 12;
         }
     }
 
+    if(!m_subdivideCloth)
+    {
+        m_indexData = triangles;
+    }
+
+    m_topology->Initialise(m_particleCount, triangles);
+    m_faceNormals.resize(triangles.size() / POINTS_IN_FACE);
+
     /* Connect neighbouring particles with springs
     ------ x
     |  |  |    Stretch/Compression: Horizontal/Vertical springs
@@ -213,23 +297,12 @@ void Cloth::CreateCloth(int rows, float spacing)
     ------              
     y */
 
-    auto createSpring = [this](int i) -> int
-    {
-        if(!m_springs[i+1].get())
-        {
-            m_springs[i+1].reset(new Spring());
-        }
-        return i+1;
-    };
-
-    m_springCount = ((m_particleLength-1)*(((m_particleLength-2)*2)+2)) 
+    ClearSprings(((m_particleLength-1)*(((m_particleLength-2)*2)+2)) 
         + (m_particleLength*(m_particleLength-1)) 
         + (m_particleLength*(m_particleLength-2))
         + ((m_particleLength-2)*m_particleLength)
-        + ((m_particleLength-1)*m_particleLength);
+        + ((m_particleLength-1)*m_particleLength));
 
-    m_springs.resize(m_springCount);
-    index = NO_INDEX;
     for(int x = 0; x < m_particleLength; ++x)
     {
         for(int y = 0; y < m_particleLength; ++y)
@@ -239,53 +312,244 @@ void Cloth::CreateCloth(int rows, float spacing)
             {
                 if(x < m_particleLength-1) //Don't create right cross if last x
                 {
-                    index = createSpring(index);
-                    m_springs[index]->Initialise(*GetParticle(x,y),
-                        *GetParticle(x+1,y+1), index, Spring::SHEAR);
+                    AddSpring(GetParticleIndex(x,y),
+                        GetParticleIndex(x+1,y+1), Spring::SHEAR);
                 }
 
                 if(x > 0) //Don't create left cross if first x
                 {
-                    index = createSpring(index);
-                    m_springs[index]->Initialise(*GetParticle(x,y),
-                        *GetParticle(x-1,y+1), index, Spring::SHEAR);
+                    AddSpring(GetParticleIndex(x,y),
+                        GetParticleIndex(x-1,y+1), Spring::SHEAR);
                 }
             }
 
             //Last 2 xs doesn't have bending horizontal springs
             if(x < m_particleLength-2)
             {
-                index = createSpring(index);
-                m_springs[index]->Initialise(*GetParticle(x,y),
-                    *GetParticle(x+2,y), index, Spring::BEND);
+                AddSpring(GetParticleIndex(x,y),
+                    GetParticleIndex(x+2,y), Spring::BEND);
             }
 
             //Last x doesn't have horizontal springs
             if(x < m_particleLength-1)
             {
-                index = createSpring(index);
-                m_springs[index]->Initialise(*GetParticle(x,y),
-                    *GetParticle(x+1,y), index, Spring::STRETCH);
+                AddSpring(GetParticleIndex(x,y),
+                    GetParticleIndex(x+1,y), Spring::STRETCH);
             }
 
             //Last 2ys doesn't have bending vertical springs
             if(y < m_particleLength-2)
             {
-                index = createSpring(index);
-                m_springs[index]->Initialise(*GetParticle(x,y),
-                    *GetParticle(x,y+2), index, Spring::BEND);
+                AddSpring(GetParticleIndex(x,y),
+                    GetParticleIndex(x,y+2), Spring::BEND);
             }
             
             //Last y doesn't have vertical springs
             if(y < m_particleLength-1)
             {
-                index = createSpring(index);
-                m_springs[index]->Initialise(*GetParticle(x,y),
-                    *GetParticle(x,y+1), index, Spring::STRETCH);
+                AddSpring(GetParticleIndex(x,y),
+                    GetParticleIndex(x,y+1), Spring::STRETCH);
             }
         }
     }
 
+    PartitionSprings();
+    CreateMesh();
+}
+
+bool Cloth::LoadMesh(const std::string& path)
+{
+    std::string errorBuffer;
+    Assimpmesh mesh;
+    if(!mesh.Initialise(path, errorBuffer))
+    {
+        ShowMessageBox(errorBuffer);
+        return false;
+    }
+
+    std::vector<D3DXVECTOR3> positions;
+    std::vector<D3DXVECTOR2> uvs;
+    std::vector<DWORD> triangles;
+
+    for(const Assimpmesh::SubMesh& subMesh : mesh.GetMeshes())
+    {
+        const DWORD offset = static_cast<DWORD>(positions.size());
+        for(const Assimpmesh::Vertex& vertex : subMesh.vertices)
+        {
+            positions.push_back(D3DXVECTOR3(vertex.x, vertex.y, vertex.z));
+            uvs.push_back(D3DXVECTOR2(vertex.u, vertex.v));
+        }
+        for(unsigned long index : subMesh.indices)
+        {
+            triangles.push_back(offset + index);
+        }
+    }
+
+    ClothTopology::WeldVertices(positions, uvs, triangles);
+    if(triangles.empty())
+    {
+        ShowMessageBox("Cloth model " + path + " has no triangles");
+        return false;
+    }
+    ClothTopology::OrderVertices(positions, uvs, triangles);
+
+    // Hang the top of the model at the same place as the grid
+    D3DXVECTOR3 minimum(positions[0]), maximum(positions[0]);
+    for(const D3DXVECTOR3& position : positions)
+    {
+        D3DXVec3Minimize(&minimum, &minimum, &position);
+        D3DXVec3Maximize(&maximum, &maximum, &position);
+    }
+
+    const D3DXVECTOR3 top((minimum.x + maximum.x) * 0.5f, 
+        maximum.y, (minimum.z + maximum.z) * 0.5f);
+
+    for(D3DXVECTOR3& position : positions)
+    {
+        position += STARTING_POSITION - top;
+    }
+
+    CreateCloth(positions, uvs, triangles);
+    return true;
+}
+
+void Cloth::CreateCloth(const std::vector<D3DXVECTOR3>& positions,
+                        const std::vector<D3DXVECTOR2>& uvs,
+                        const std::vector<DWORD>& triangles)
+{
+    m_particleLength = 0;
+    m_particleCount = static_cast<int>(positions.size());
+    m_quadVertices = 0;
+    m_layout->Initialise(0, m_layoutOrder);
+    m_indexData = triangles;
+
+    m_topology->Initialise(m_particleCount, triangles);
+    m_faceNormals.resize(triangles.size() / POINTS_IN_FACE);
+
+    // Spacing follows the average edge to size the particle collisions
+    const std::vector<ClothTopology::Edge>& edges = m_topology->GetEdges();
+    float edgeLength = 0.0f;
+    int sharedEdges = 0;
+    for(const ClothTopology::Edge& edge : edges)
+    {
+        edgeLength += D3DXVec3Length(&(positions[edge.index2] - positions[edge.index1]));
+        sharedEdges += edge.opposite2 != NO_INDEX ? 1 : 0;
+    }
+    m_spacing = edges.empty() ? SPACING : edgeLength / edges.size();
+
+    CreateParticles(positions, uvs, m_particleCount/2);
+
+    /* Connect particles of the triangles with springs
+    Stretch/Compression: Each edge
+    Shear: Across the longest edge of both triangles sharing it, the diagonal of a quad
+    Bending: Across any other edge shared by two triangles */
+
+    auto isLongest = [&positions](int index1, int index2, int opposite) -> bool
+    {
+        const float length = D3DXVec3LengthSq(&(positions[index2] - positions[index1]));
+        return length >= D3DXVec3LengthSq(&(positions[opposite] - positions[index1])) &&
+               length >= D3DXVec3LengthSq(&(positions[opposite] - positions[index2]));
+    };
+
+    ClearSprings(static_cast<int>(edges.size()) + sharedEdges);
+    for(const ClothTopology::Edge& edge : edges)
+    {
+        AddSpring(edge.index1, edge.index2, Spring::STRETCH);
+
+        if(edge.opposite2 != NO_INDEX)
+        {
+            const bool diagonal = 
+                isLongest(edge.index1, edge.index2, edge.opposite1) &&
+                isLongest(edge.index1, edge.index2, edge.opposite2);
+
+            AddSpring(edge.opposite1, edge.opposite2, 
+                diagonal ? Spring::SHEAR : Spring::BEND);
+        }
+    }
+
+    PartitionSprings();
+    CreateMesh();
+}
+
+void Cloth::CreateParticles(const std::vector<D3DXVECTOR3>& positions,
+                            const std::vector<D3DXVECTOR2>& uvs,
+                            int diagnosticParticle)
+{
+    const int current = static_cast<int>(m_particles.size());
+    if(m_diagnosticParticle < current)
+    {
+        auto& collision = m_particles[m_diagnosticParticle]->GetCollisionMesh();
+        collision.SetRenderSolverDiagnostics(false);
+    }
+
+    // Remove any particles from octree no longer needed and keep them for reuse
+    for(int i = m_particleCount; i < current; ++i)
+    {
+        m_engine->octree()->RemoveObject(m_particles[i]->GetCollisionMesh());
+        m_spareParticles.push_back(std::move(m_particles[i]));
+    }
+
+    // Create the vertices
+    const int vertexCount = m_particleCount + m_quadVertices;
+    m_vertexData.resize(vertexCount);
+
+    // Create the particles; those already in the cloth keep their
+    // collision instance unless the spacing has changed its scale
+    const int existing = min(current, m_particleCount);
+    const float scale = m_spacing/2.0f;
+    const bool rescaled = m_template->GetLocalScale().x != scale;
+    m_store->Resize(m_particleCount);
+    m_particles.resize(m_particleCount);
+    m_template->SetLocalScale(scale);
+    const float visualRadius = GetVisualRadius(m_spacing);
+
+    for(int index = 0; index < m_particleCount; ++index)
+    {
+        m_store->Initialise(index, positions[index]);
+        m_vertexData[index].uvs = uvs[index];
+
+        if(index < existing)
+        {
+            if(rescaled)
+            {
+                m_particles[index]->Initialise(index, *m_template, visualRadius);
+            }
+            else
+            {
+                m_particles[index]->ResetPosition();
+            }
+            continue;
+        }
+
+        if(m_spareParticles.empty())
+        {
+            m_particles[index].reset(new Particle(m_engine, *m_store));
+        }
+        else
+        {
+            m_particles[index] = std::move(m_spareParticles.back());
+            m_spareParticles.pop_back();
+        }
+
+        m_particles[index]->Initialise(index, *m_template, visualRadius);
+        m_engine->octree()->AddObject(m_particles[index]->GetCollisionMesh());
+    }
+
+    // Reused particles may still be colored for a pin they no longer have
+    for(const ParticlePtr& particle : m_particles)
+    {
+        SetParticleColor(particle);
+    }
+
+    SavePreviousState();
+
+    m_diagnosticParticle = diagnosticParticle;
+    auto& collision = m_particles[m_diagnosticParticle]->GetCollisionMesh();
+    collision.SetRenderSolverDiagnostics(true);
+}
+
+void Cloth::CreateMesh()
+{
     //Mesh Vertex Declaration
     D3DVERTEXELEMENT9 VertexDec[] =
     {
@@ -295,14 +559,18 @@ void Cloth::CreateCloth(int rows, float spacing)
         D3DDECL_END()
     };
 
-    //Create the mesh
-    if(m_mesh)
+    //Create the mesh; the current mesh is kept if large enough without wasting too much
+    const DWORD faceCount = m_indexData.size() / POINTS_IN_FACE;
+    const DWORD vertexCount = m_vertexData.size();
+    if(m_mesh && (m_mesh->GetNumFaces() < faceCount ||
+        m_mesh->GetNumVertices() < vertexCount ||
+        m_mesh->GetNumFaces() > faceCount * MESH_SHRINK_FACTOR))
     {
         m_mesh->Release();
         m_mesh = nullptr;
     }
 
-    if(FAILED(D3DXCreateMesh(triangleNumber, m_vertexData.size(),
+    if(!m_mesh && FAILED(D3DXCreateMesh(faceCount, vertexCount,
         D3DXMESH_VB_DYNAMIC | D3DXMESH_IB_MANAGED | D3DXMESH_32BIT,
         VertexDec, m_engine->device(), &m_mesh)))
     {
@@ -330,6 +598,10 @@ void Cloth::CreateCloth(int rows, float spacing)
         ShowMessageBox("Cloth Index buffer lock failed");
     }
     std::copy(m_indexData.begin(), m_indexData.end(), (DWORD*)indexdata);
+
+    // Faces past the cloth in a reused mesh are collapsed onto the first vertex
+    std::fill((DWORD*)indexdata + m_indexData.size(),
+        (DWORD*)indexdata + (m_mesh->GetNumFaces() * POINTS_IN_FACE), 0);
     m_mesh->UnlockIndexBuffer();
 }
 
@@ -357,66 +629,501 @@ void Cloth::Draw(const D3DXVECTOR3& cameraPos, const Matrix& projection, const M
         m_mesh->DrawSubset(0);
         m_shader->EndPass();
     }
-    m_shader->End();
+    m_shader->End();
+}
+
+void Cloth::SetHandleMode(bool set)
+{
+    m_handleMode = set;
+    ChangeRow(m_selectedRow, m_handleMode);
+}
+
+void Cloth::SetVertexVisibility(bool draw)
+{
+    m_drawVisualParticles = draw;
+}
+
+void Cloth::SetCollisionVisibility(bool draw)
+{
+    m_drawColParticles = draw;
+}
+
+void Cloth::UnpinCloth()
+{
+    auto unpinParticle = [this](const ParticlePtr& part)
+    { 
+        part->PinParticle(false); 
+        SetParticleColor(part);
+    };
+    std::for_each(m_particles.begin(), m_particles.end(), unpinParticle);
+}
+
+void Cloth::AddForce(const D3DXVECTOR3& force)
+{
+    m_store->AddForce(force);
+}
+
+void Cloth::PreCollisionUpdate(float deltatime)
+{
+    UpdateDiagnostics();
+    SavePreviousState();
+
+    // Move cloth down slowly
+    if(m_simulation)
+    {
+        AddForce(m_gravity*m_timestepSquared*deltatime);
+    }
+    
+    if(m_integrator == IMPLICIT_EULER)
+    {
+        // All spring forces are solved together so no spring iterations are needed
+        m_implicit->Step(*m_packedSprings, *m_store, m_stiffness, 
+            m_bendSprings, m_timestep, m_damping);
+        SolveAttachments();
+        LimitStrain();
+    }
+    else if(m_solver == XPBD)
+    {
+        // Each substep predicts the positions then corrects them; compliance
+        // is scaled by the substep time so the material response does not 
+        // depend on the iterations or timestep
+        const float substep = m_timestep / m_substeps;
+        const float damping = std::pow(m_damping, 1.0f / m_substeps);
+        for(int i = 0; i < m_substeps; ++i)
+        {
+            m_store->Integrate(damping, substep*substep);
+            SolveSprings();
+            LimitStrain();
+        }
+    }
+    else
+    {
+        SolveSprings();
+        LimitStrain();
+
+        // Updating particle positions
+        m_store->Integrate(m_damping, m_timestepSquared);
+    }
+
+    m_store->ClearAccelerations();
+    UpdateCollisionPositions();
+}
+
+void Cloth::ClearSprings(int count)
+{
+    m_springs.clear();
+    m_springs.reserve(count);
+    m_packedSprings->index1.clear();
+    m_packedSprings->index1.reserve(count);
+    m_packedSprings->index2.clear();
+    m_packedSprings->index2.reserve(count);
+    m_packedSprings->rest.clear();
+    m_packedSprings->rest.reserve(count);
+}
+
+void Cloth::AddSpring(int index1, int index2, Spring::Type type)
+{
+    const D3DXVECTOR3 difference = m_store->GetPosition(index1) - m_store->GetPosition(index2);
+    m_springs.push_back(Spring(static_cast<int>(m_springs.size()), type));
+    m_packedSprings->index1.push_back(index1);
+    m_packedSprings->index2.push_back(index2);
+    m_packedSprings->rest.push_back(D3DXVec3Length(&difference));
+}
+
+void Cloth::PartitionSprings()
+{
+    m_springCount = static_cast<int>(m_springs.size());
+    PackedSprings& springs = *m_packedSprings;
+
+    // Greedily give each spring the lowest batch not already used by either of its
+    // particles. Grid particles have at most twelve springs but mesh vertices may 
+    // have any number, so batches are found a window at a time with a bit for each
+    // and springs whose particles have filled the window wait for the next one
+    std::vector<unsigned int> particleBatches(m_particleCount);
+    std::vector<int> springBatch(m_springCount, NO_INDEX);
+    int batchCount = 0;
+    int remaining = m_springCount;
+
+    for(int window = 0; remaining > 0; window += BATCH_WINDOW)
+    {
+        std::fill(particleBatches.begin(), particleBatches.end(), 0);
+        for(int i = 0; i < m_springCount; ++i)
+        {
+            const int index1 = springs.index1[i];
+            const int index2 = springs.index2[i];
+            const unsigned int used = particleBatches[index1] | particleBatches[index2];
+            if(springBatch[i] != NO_INDEX || used == ~0u)
+            {
+                continue;
+            }
+
+            int batch = 0;
+            while(used & (1u << batch))
+            {
+                ++batch;
+            }
+
+            particleBatches[index1] |= 1u << batch;
+            particleBatches[index2] |= 1u << batch;
+            springBatch[i] = window + batch;
+            batchCount = max(batchCount, springBatch[i]+1);
+            --remaining;
+        }
+    }
+
+    // Group the springs by batch, then by type so each type can be solved by its own 
+    // kernel, then by the region holding both of their particles; springs joining 
+    // two regions come first in each type and are always solved while sleeping 
+    // regions are skipped
+    m_sleep->Initialise(m_particleCount, *m_layout);
+    const int groups = m_sleep->GetRegionCount()+1;
+    const int groupCount = batchCount*Spring::MAX_TYPES*groups;
+    std::vector<int> springGroup(m_springCount, 0);
+    m_regionSprings.assign(groupCount+1, 0);
+    for(int i = 0; i < m_springCount; ++i)
+    {
+        const int region1 = m_sleep->GetRegion(springs.index1[i]);
+        const int region2 = m_sleep->GetRegion(springs.index2[i]);
+        const int block = (springBatch[i]*Spring::MAX_TYPES) + m_springs[i].GetType();
+        springGroup[i] = (block*groups) + (region1 == region2 ? region1+1 : 0);
+        ++m_regionSprings[springGroup[i]+1];
+    }
+    for(unsigned int i = 1; i < m_regionSprings.size(); ++i)
+    {
+        m_regionSprings[i] += m_regionSprings[i-1];
+    }
+
+    // Each type of spring in a batch is its own run so solvers reading all 
+    // springs look up the material once for each run rather than each spring
+    springs.typeStart.resize((batchCount*Spring::MAX_TYPES)+1);
+    for(unsigned int i = 0; i < springs.typeStart.size(); ++i)
+    {
+        springs.typeStart[i] = m_regionSprings[i*groups];
+    }
+
+    // Within each group the springs are ordered by their first particle so each 
+    // run walks forward through the particles; sorted least significant first
+    std::vector<int> order(m_springCount);
+    for(int i = 0; i < m_springCount; ++i)
+    {
+        order[i] = i;
+    }
+    SortByKey(order, springs.index1.data(), m_particleCount);
+    SortByKey(order, springGroup.data(), groupCount);
+
+    std::vector<Spring> sortedSprings;
+    sortedSprings.reserve(m_springCount);
+    IndexArray index1(m_springCount), index2(m_springCount);
+    FloatArray rest(m_springCount);
+    for(int i = 0; i < m_springCount; ++i)
+    {
+        const int spring = order[i];
+        sortedSprings.push_back(m_springs[spring]);
+        index1[i] = springs.index1[spring];
+        index2[i] = springs.index2[spring];
+        rest[i] = springs.rest[spring];
+    }
+    m_springs.swap(sortedSprings);
+    springs.index1.swap(index1);
+    springs.index2.swap(index2);
+    springs.rest.swap(rest);
+
+    springs.inverseRest.resize(m_springCount);
+    for(int i = 0; i < m_springCount; ++i)
+    {
+        springs.inverseRest[i] = 1.0f / springs.rest[i];
+    }
+
+    springs.weight.resize(m_springCount);
+    m_uniformSpringWeights = false;
+    m_springLambda.resize(m_springCount);
+    m_jacobi->Initialise(*m_packedSprings, m_particleCount);
+    m_implicit->Initialise(*m_packedSprings, m_particleCount);
+    m_attachments->Initialise(*m_packedSprings, m_particleCount);
+    m_membrane->Initialise(*m_store, m_topology->GetTriangles());
+    m_multigrid->Initialise(*m_store, *m_layout);
+    m_sleep->Connect(*m_packedSprings);
+    UpdateActiveSprings();
+    m_estimateRadius = true;
+}
+
+void Cloth::UpdateActiveSprings()
+{
+    // Runs of springs from neighbouring awake regions are merged together
+    // while each type of spring within a batch keeps its own runs
+    const int groups = m_sleep->GetRegionCount()+1;
+    const int blockCount = (static_cast<int>(m_regionSprings.size())-1) / groups;
+    m_activeSpringRuns.clear();
+    m_activeBatches.assign(1, 0);
+
+    for(int block = 0; block < blockCount; ++block)
+    {
+        for(int group = 0; group < groups; ++group)
+        {
+            const int start = m_regionSprings[(block*groups)+group];
+            const int end = m_regionSprings[(block*groups)+group+1];
+            if(start == end || (group > 0 && m_sleep->IsAsleep(group-1)))
+            {
+                continue;
+            }
+
+            const int runCount = static_cast<int>(m_activeSpringRuns.size());
+            if(runCount > m_activeBatches.back() && m_activeSpringRuns.back().second == start)
+            {
+                m_activeSpringRuns.back().second = end;
+            }
+            else
+            {
+                m_activeSpringRuns.push_back(std::make_pair(start, end));
+            }
+        }
+        m_activeBatches.push_back(static_cast<int>(m_activeSpringRuns.size()));
+    }
+}
+
+void Cloth::WakeRegions()
+{
+    if(m_sleep->GetSleepingCount() > 0)
+    {
+        m_sleep->WakeAll(*m_store);
+        UpdateActiveSprings();
+    }
+}
+
+bool Cloth::HasInteractingParticles() const
+{
+    for(int i = 0; i < m_particleCount; ++i)
+    {
+        if(!IsZeroVector(m_store->GetInteractingVelocity(i)))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Cloth::UpdateSpringWeights()
+{
+    if(!HasInteractingParticles())
+    {
+        if(!m_uniformSpringWeights)
+        {
+            std::fill(m_packedSprings->weight.begin(), m_packedSprings->weight.end(), 0.5f);
+            m_uniformSpringWeights = true;
+        }
+        return;
+    }
+
+    for(int i = 0; i < m_springCount; ++i)
+    {
+        m_packedSprings->weight[i] = GetInteractingWeight(
+            m_store->GetInteractingVelocity(m_packedSprings->index1[i]),
+            m_store->GetInteractingVelocity(m_packedSprings->index2[i]));
+    }
+    m_uniformSpringWeights = false;
+}
+
+void Cloth::SolveSprings()
+{
+    if(m_solver == STENCIL && m_particleLength > 0)
+    {
+        // Grid springs are found from each particle so no packed spring data is read
+        const bool interacting = HasInteractingParticles();
+        for(int j = 0; j < m_springIterations; ++j)
+        {
+            m_stencil->Solve(*m_store, *m_layout, m_spacing, interacting, m_bendSprings);
+            SolveAttachments();
+        }
+        return;
+    }
+
+    // Springs in a batch share no particles and can be solved in any order; 
+    // batches are solved in sequence to keep the Gauss-Seidel propagation.
+    // Cloth without grid rows solves the batches when the stencil is chosen
+    UpdateSpringWeights();
+
+    if(m_solver == MULTIGRID)
+    {
+        // Each iteration is a V-cycle smoothing the full resolution springs twice
+        m_multigrid->Solve(*m_store, [this]()
+        {
+            SolveSpringBatches();
+            SolveAttachments();
+        }, m_springIterations);
+        return;
+    }
+
+    if(m_solver == XPBD)
+    {
+        std::fill(m_springLambda.begin(), m_springLambda.end(), 0.0f);
+    }
+
+    const std::function<void(void)> iterate = [this]()
+    {
+        if(m_solver == JACOBI)
+        {
+            m_jacobi->Solve(*m_packedSprings, *m_store, 1, m_bendSprings);
+        }
+        else
+        {
+            SolveSpringBatches();
+        }
+    };
+
+    // Extrapolation relies on the symmetric averaged Jacobi update; the sequential 
+    // Gauss-Seidel and XPBD updates diverge when extrapolated so are not accelerated
+    const bool accelerate = m_accelerate && m_solver == JACOBI;
+    if(accelerate)
+    {
+        if(m_estimateRadius && m_accelerator->IsAutoEstimating())
+        {
+            m_estimateRadius = !m_accelerator->Estimate(*m_store, iterate);
+        }
+        m_accelerator->Begin(*m_store);
+    }
+
+    for(int j = 0; j < m_springIterations; ++j)
+    {
+        iterate();
+
+        if(accelerate)
+        {
+            m_accelerator->Accelerate(*m_store);
+        }
+
+        // Attachments are applied outside the accelerated update which 
+        // relies on the iterations being linear in the positions
+        SolveAttachments();
+    }
 }
 
-void Cloth::SetHandleMode(bool set)
+void Cloth::SolveAttachments()
 {
-    m_handleMode = set;
-    ChangeRow(m_selectedRow, m_handleMode);
+    // Pins only change between ticks so the nearest pins are found at most once a tick
+    if(m_attach)
+    {
+        m_attachments->Update(*m_store);
+        m_attachments->Solve(*m_store);
+    }
 }
 
-void Cloth::SetVertexVisibility(bool draw)
+void Cloth::SolveSpringBatches()
 {
-    m_drawVisualParticles = draw;
+    // The membrane triangles are all solved first as they are batched separately
+    if(m_solveMembrane)
+    {
+        m_membrane->Solve(*m_store, MEMBRANE_STIFFNESS);
+    }
+
+    // Each combination of settings has its own kernels so no spring is 
+    // checked for its type or whether the particles are interacting
+    if(m_bendSprings)
+    {
+        if(m_uniformSpringWeights)
+        {
+            SolveSpringTypes<true, false, false>();
+        }
+        else
+        {
+            SolveSpringTypes<true, true, false>();
+        }
+    }
+    else
+    {
+        if(m_uniformSpringWeights)
+        {
+            SolveSpringTypes<false, false, false>();
+        }
+        else
+        {
+            SolveSpringTypes<false, true, false>();
+        }
+    }
 }
 
-void Cloth::SetCollisionVisibility(bool draw)
+void Cloth::LimitStrain()
 {
-    m_drawColParticles = draw;
+    // Bend springs are not limited so the cloth can still fold over itself
+    if(m_limitStrain)
+    {
+        if(m_uniformSpringWeights)
+        {
+            SolveSpringTypes<false, false, true>();
+        }
+        else
+        {
+            SolveSpringTypes<false, true, true>();
+        }
+    }
 }
 
-void Cloth::UnpinCloth()
+template<bool Bend, bool Interacting, bool Limit>
+void Cloth::SolveSpringTypes()
 {
-    auto unpinParticle = [this](const ParticlePtr& part)
-    { 
-        part->PinParticle(false); 
-        SetParticleColor(part);
-    };
-    std::for_each(m_particles.begin(), m_particles.end(), unpinParticle);
+    // The membrane replaces the stretch and shear springs but not their limits
+    const bool planar = Limit || !m_solveMembrane;
+    const int batchCount = (static_cast<int>(m_activeBatches.size())-1) / Spring::MAX_TYPES;
+    for(int batch = 0; batch < batchCount; ++batch)
+    {
+        if(planar)
+        {
+            SolveSpringRuns<Spring::STRETCH, Interacting, Limit>(batch);
+            SolveSpringRuns<Spring::SHEAR, Interacting, Limit>(batch);
+        }
+        if(Bend)
+        {
+            SolveSpringRuns<Spring::BEND, Interacting, Limit>(batch);
+        }
+    }
 }
 
-void Cloth::AddForce(const D3DXVECTOR3& force)
+template<Spring::Type Type, bool Interacting, bool Limit>
+void Cloth::SolveSpringRuns(int batch)
 {
-    for(const ParticlePtr& particle : m_particles)
+    // Springs inside sleeping regions are left out of the runs until they wake
+    const int block = (batch*Spring::MAX_TYPES) + Type;
+    for(int run = m_activeBatches[block]; run < m_activeBatches[block+1]; ++run)
     {
-        particle->AddForce(force);
+        const int start = m_activeSpringRuns[run].first;
+        const int count = m_activeSpringRuns[run].second - start;
+
+        if(count < MIN_PARALLEL_SPRINGS)
+        {
+            SolveSpringRange<Type, Interacting, Limit>(start, start+count);
+        }
+        else
+        {
+            m_threads->ParallelFor(count, [this, start](int begin, int end)
+                { SolveSpringRange<Type, Interacting, Limit>(start+begin, start+end); });
+        }
     }
 }
 
-void Cloth::PreCollisionUpdate(float deltatime)
+template<Spring::Type Type, bool Interacting, bool Limit>
+void Cloth::SolveSpringRange(int begin, int end)
 {
-    UpdateDiagnostics();
-
-    // Move cloth down slowly
-    if(m_simulation)
+    if(Limit)
     {
-        AddForce(m_gravity*m_timestepSquared*deltatime);
+        m_springKernel->Limit<Type, Interacting>(*m_packedSprings, 
+            *m_store, m_minStretch, m_maxStretch, begin, end);
     }
-    
-    // Solve Springs
-    for(int j = 0; j < m_springIterations; ++j)
+    else if(m_solver == XPBD)
     {
-        for(const SpringPtr& spring : m_springs)
-        {
-            spring->SolveSpring(m_timestep);
-        }
+        const float substep = m_timestep / m_substeps;
+        m_springKernel->SolveCompliant<Type, Interacting>(*m_packedSprings, *m_store, 
+            m_springLambda.data(), m_compliance[Type], substep*substep, begin, end);
+    }
+    else
+    {
+        m_springKernel->Solve<Type, Interacting>(*m_packedSprings, *m_store, begin, end);
     }
+}
 
-    // Updating particle positions
+void Cloth::UpdateCollisionPositions()
+{
     for(const ParticlePtr& particle : m_particles)
     {
-        particle->PreCollisionUpdate(m_damping, m_timestepSquared);
+        particle->UpdateCollisionPosition();
     }
 }
 
@@ -427,32 +1134,70 @@ void Cloth::UpdateDiagnostics()
 
     if(renderer.AllowDiagnostics(Diagnostic::CLOTH))
     {
-        std::for_each(m_springs.begin(), m_springs.end(), 
-            [this, &renderer](const SpringPtr& spring)
-            { 
-                spring->UpdateDiagnostic(renderer); 
-            });
+        for(int i = 0; i < m_springCount; ++i)
+        {
+            m_springs[i].UpdateDiagnostic(renderer, *m_store,
+                m_packedSprings->index1[i], m_packedSprings->index2[i]);
+        }
 
         renderer.UpdateText(Diagnostic::CLOTH, 
             "ParticleCount", Diagnostic::WHITE, StringCast(m_particleCount));
 
         renderer.UpdateText(Diagnostic::CLOTH, 
             "Smoothing", Diagnostic::WHITE, StringCast(m_generalSmoothing));
+
+        renderer.UpdateText(Diagnostic::CLOTH, 
+            "Solver", Diagnostic::WHITE, GetSolverName(m_solver));
+
+        renderer.UpdateText(Diagnostic::CLOTH, 
+            "Integrator", Diagnostic::WHITE, GetIntegratorName(m_integrator));
+
+        renderer.UpdateText(Diagnostic::CLOTH, 
+            "Layout", Diagnostic::WHITE, GridLayout::GetOrderName(m_layoutOrder));
+
+        renderer.UpdateText(Diagnostic::CLOTH, 
+            "BendSprings", Diagnostic::WHITE, m_bendSprings ? "On" : "Off");
+
+        renderer.UpdateText(Diagnostic::CLOTH, 
+            "Attachments", Diagnostic::WHITE, m_attach ? 
+            StringCast(m_attachments->GetAttachedCount()) : "Off");
+
+        renderer.UpdateText(Diagnostic::CLOTH, 
+            "Membrane", Diagnostic::WHITE, m_solveMembrane ? 
+            StringCast(m_membrane->GetTriangleCount()) : "Off");
+
+        renderer.UpdateText(Diagnostic::CLOTH, 
+            "StrainLimits", Diagnostic::WHITE, m_limitStrain ? 
+            StringCast(m_minStretch) + " to " + StringCast(m_maxStretch) : "Off");
+
+        renderer.UpdateText(Diagnostic::CLOTH, 
+            "Chebyshev", Diagnostic::WHITE, m_accelerate ? 
+            StringCast(m_accelerator->GetSpectralRadius()) : "Off");
+
+        renderer.UpdateText(Diagnostic::CLOTH, 
+            "ImplicitIterations", Diagnostic::WHITE, StringCast(m_implicit->GetIterations()));
+
+        renderer.UpdateText(Diagnostic::CLOTH, 
+            "SleepingRegions", Diagnostic::WHITE, m_allowSleeping ? 
+            StringCast(m_sleep->GetSleepingCount()) + "/" + 
+            StringCast(m_sleep->GetRegionCount()) : "Off");
     }
 }
 
 void Cloth::Reset()
 {
+    WakeRegions();
     for(const ParticlePtr& particle : m_particles)
     {
         particle->ResetPosition();
     }
+    SavePreviousState();
     UpdateVertexBuffer();
 }
 
-Cloth::ParticlePtr& Cloth::GetParticle(int row, int column)
+int Cloth::GetParticleIndex(int row, int column) const
 {
-    return m_particles[(column * m_particleLength) + row];
+    return m_layout->GetParticle(column, row);
 }
 
 void Cloth::DrawCollisions(const Matrix& projection, const Matrix& view)
@@ -528,11 +1273,12 @@ void Cloth::MovePinnedRow(float right, float up, float forward)
     if(m_handleMode)
     {
         D3DXVECTOR3 direction(right, up, forward);
-        for(const ParticlePtr& particle : m_particles)
+        for(int i = 0; i < m_particleCount; ++i)
         {
-            if(particle->IsSelected())
+            if(m_store->HasFlag(i, ParticleStore::SELECTED))
             { 
-                particle->AddForce(direction); 
+                m_store->SetSleeping(i, false);
+                m_store->AddForce(i, direction); 
             } 
         }
     }
@@ -557,16 +1303,16 @@ void Cloth::ChangeRow(int row, bool select)
     switch(row)
     {
     case 1:
-        getIndexFn = [&](){ index = counter; };
+        getIndexFn = [&](){ index = GetParticleIndex(counter, 0); };
         break;
     case 2:
-        getIndexFn = [&](){ index = (m_particleLength*counter) + (m_particleLength-1); };
+        getIndexFn = [&](){ index = GetParticleIndex(m_particleLength-1, counter); };
         break;
     case 3:
-        getIndexFn = [&](){ index = (m_particleLength*(m_particleLength-1))+counter; };
+        getIndexFn = [&](){ index = GetParticleIndex(counter, m_particleLength-1); };
         break;
     case 4:
-        getIndexFn = [&](){ index = m_particleLength*counter; };
+        getIndexFn = [&](){ index = GetParticleIndex(0, counter); };
         break;
     }
 
@@ -580,17 +1326,52 @@ void Cloth::ChangeRow(int row, bool select)
 
 void Cloth::SetSpacing(double size)
 {
-    if(size != m_spacing)
+    if(size != m_spacing && size > 0.0)
+    {
+        RescaleCloth(static_cast<float>(size));
+    }
+}
+
+void Cloth::RescaleCloth(float spacing)
+{
+    // The topology is unchanged so the particles, springs and mesh are kept
+    // and the cloth is scaled about the point it initially hangs from
+    const float scale = spacing / m_spacing;
+    m_spacing = spacing;
+    WakeRegions();
+
+    m_template->SetLocalScale(m_spacing/2.0f);
+    const float visualRadius = GetVisualRadius(m_spacing);
+    for(int index = 0; index < m_particleCount; ++index)
+    {
+        const D3DXVECTOR3 offset = m_store->GetInitialPosition(index) - STARTING_POSITION;
+        m_store->Initialise(index, STARTING_POSITION + (offset * scale));
+        m_particles[index]->Initialise(index, *m_template, visualRadius);
+    }
+
+    auto& collision = m_particles[m_diagnosticParticle]->GetCollisionMesh();
+    collision.SetRenderSolverDiagnostics(true);
+
+    for(int i = 0; i < m_springCount; ++i)
     {
-        CreateCloth(m_particleLength, static_cast<float>(size));
+        m_packedSprings->rest[i] *= scale;
+        m_packedSprings->inverseRest[i] /= scale;
     }
+    m_multigrid->ScaleRestDistances(scale);
+    m_attachments->ScaleRestDistances(scale);
+    m_membrane->ScaleRestShapes(scale);
+    m_estimateRadius = true;
+
+    SavePreviousState();
+    UpdateVertexBuffer();
 }
 
 void Cloth::SetVertexRows(double number)
 {
     if(number != m_particleLength)
     {
-        CreateCloth(static_cast<int>(number), m_spacing);
+        // Restoring the zero rows of a mesh cloth returns to the initial grid
+        CreateCloth(number > 0.0 ? static_cast<int>(number) : ROWS, m_spacing);
     }
 }
 
@@ -615,6 +1396,222 @@ double Cloth::GetIterations() const
     return m_springIterations;
 }
 
+void Cloth::SetSolver(Solver solver)
+{
+    m_solver = solver;
+    m_estimateRadius = true;
+}
+
+void Cloth::ToggleSolver()
+{
+    SetSolver(static_cast<Solver>((m_solver + 1) % MAX_SOLVERS));
+}
+
+std::string Cloth::GetSolverName(Solver solver)
+{
+    switch(solver)
+    {
+    case GAUSS_SEIDEL:
+        return "Gauss-Seidel";
+    case JACOBI:
+        return "Jacobi";
+    case XPBD:
+        return "XPBD";
+    case MULTIGRID:
+        return "Multigrid";
+    case STENCIL:
+        return "Stencil";
+    default:
+        return "None";
+    }
+}
+
+void Cloth::SetAcceleration(bool accelerate)
+{
+    m_accelerate = accelerate;
+    m_estimateRadius = true;
+}
+
+void Cloth::ToggleAcceleration()
+{
+    SetAcceleration(!m_accelerate);
+}
+
+ChebyshevAccelerator& Cloth::GetAccelerator()
+{
+    return *m_accelerator;
+}
+
+void Cloth::SetSimulation(bool simulating)
+{
+    // Regions resting without gravity would otherwise not fall once it is enabled
+    m_simulation = simulating;
+    WakeRegions();
+}
+
+void Cloth::SetSleepingAllowed(bool allow)
+{
+    m_allowSleeping = allow;
+    if(!m_allowSleeping)
+    {
+        WakeRegions();
+    }
+}
+
+void Cloth::ToggleSleeping()
+{
+    SetSleepingAllowed(!m_allowSleeping);
+}
+
+bool Cloth::HasSleepingRegions() const
+{
+    return m_sleep->GetSleepingCount() > 0;
+}
+
+void Cloth::SetBendSprings(bool solve)
+{
+    m_bendSprings = solve;
+    m_estimateRadius = true;
+}
+
+void Cloth::ToggleBendSprings()
+{
+    SetBendSprings(!m_bendSprings);
+}
+
+void Cloth::SetAttachments(bool attach)
+{
+    m_attach = attach;
+}
+
+void Cloth::ToggleAttachments()
+{
+    SetAttachments(!m_attach);
+}
+
+void Cloth::SetMembrane(bool solve)
+{
+    m_solveMembrane = solve;
+}
+
+void Cloth::ToggleMembrane()
+{
+    SetMembrane(!m_solveMembrane);
+}
+
+int Cloth::GetMembraneTriangleCount() const
+{
+    return m_membrane->GetTriangleCount();
+}
+
+void Cloth::SetStrainLimiting(bool limit)
+{
+    m_limitStrain = limit;
+}
+
+void Cloth::ToggleStrainLimiting()
+{
+    SetStrainLimiting(!m_limitStrain);
+}
+
+void Cloth::SetStrainLimits(float minStretch, float maxStretch)
+{
+    m_minStretch = min(minStretch, 1.0f);
+    m_maxStretch = max(maxStretch, 1.0f);
+}
+
+void Cloth::SetLayout(GridLayout::Order order)
+{
+    if(order != m_layoutOrder)
+    {
+        m_layoutOrder = order;
+        if(m_particleLength > 0)
+        {
+            CreateCloth(m_particleLength, m_spacing);
+        }
+    }
+}
+
+void Cloth::ToggleLayout()
+{
+    SetLayout(static_cast<GridLayout::Order>(
+        (m_layoutOrder + 1) % GridLayout::MAX_ORDERS));
+}
+
+void Cloth::SetCompliance(Spring::Type type, float compliance)
+{
+    m_compliance[type] = compliance;
+}
+
+float Cloth::GetCompliance(Spring::Type type) const
+{
+    return m_compliance[type];
+}
+
+void Cloth::SetStiffness(Spring::Type type, float stiffness)
+{
+    m_stiffness[type] = stiffness;
+}
+
+float Cloth::GetStiffness(Spring::Type type) const
+{
+    return m_stiffness[type];
+}
+
+void Cloth::ToggleIntegrator()
+{
+    SetIntegrator(static_cast<Integrator>((m_integrator + 1) % MAX_INTEGRATORS));
+}
+
+std::string Cloth::GetIntegratorName(Integrator integrator)
+{
+    switch(integrator)
+    {
+    case VERLET:
+        return "Verlet";
+    case IMPLICIT_EULER:
+        return "Implicit Euler";
+    default:
+        return "None";
+    }
+}
+
+void Cloth::SetSubsteps(int substeps)
+{
+    m_substeps = max(substeps, 1);
+}
+
+double Cloth::GetSpringResidual() const
+{
+    double sum = 0.0;
+    for(int i = 0; i < m_springCount; ++i)
+    {
+        const D3DXVECTOR3 difference = m_store->GetPosition(m_packedSprings->index2[i])
+            - m_store->GetPosition(m_packedSprings->index1[i]);
+
+        const double stretch = (D3DXVec3Length(&difference) * m_packedSprings->inverseRest[i]) - 1.0;
+        sum += stretch * stretch;
+    }
+    return m_springCount > 0 ? std::sqrt(sum / m_springCount) : 0.0;
+}
+
+double Cloth::GetMaxStrain() const
+{
+    double strain = 0.0;
+    for(int i = 0; i < m_springCount; ++i)
+    {
+        if(m_springs[i].GetType() != Spring::BEND)
+        {
+            const D3DXVECTOR3 difference = m_store->GetPosition(m_packedSprings->index2[i])
+                - m_store->GetPosition(m_packedSprings->index1[i]);
+
+            const double stretch = (D3DXVec3Length(&difference) * m_packedSprings->inverseRest[i]) - 1.0;
+            strain = max(strain, std::fabs(stretch));
+        }
+    }
+    return strain;
+}
+
 double Cloth::GetVertexRows() const
 {
     return m_particleLength;
@@ -630,6 +1627,16 @@ std::vector<Cloth::ParticlePtr>& Cloth::GetParticles()
     return m_particles;
 }
 
+ParticleStore& Cloth::GetParticleStore()
+{
+    return *m_store;
+}
+
+SpringKernel& Cloth::GetSpringKernel()
+{
+    return *m_springKernel;
+}
+
 void Cloth::PostCollisionUpdate()
 {
     // Update the collision mesh last after all movement has been decided
@@ -638,9 +1645,24 @@ void Cloth::PostCollisionUpdate()
         particle->PostCollisionUpdate();
     }
 
+    if(m_allowSleeping && m_sleep->Update(*m_store, m_previousState, m_spacing))
+    {
+        UpdateActiveSprings();
+    }
+}
+
+void Cloth::UpdateRenderState(float interpolation)
+{
+    m_interpolation = interpolation;
     UpdateVertexBuffer();
 }
 
+void Cloth::SavePreviousState()
+{
+    const ParticleStore::VectorArray& positions = m_store->GetPositions();
+    m_previousState.assign(positions.begin(), positions.end());
+}
+
 bool Cloth::UpdateVertexBuffer()
 {
     UpdateVertices();
@@ -682,48 +1704,42 @@ void Cloth::ChangeSmoothing(bool increase)
 
 void Cloth::UpdateVertices()
 {
-    int index = NO_INDEX;
-    D3DXVECTOR3 normal(0.0f, 0.0f, 0.0f);
+    const D3DXVECTOR3 normal(0.0f, 0.0f, 0.0f);
+    const ParticleStore::VectorArray& positions = m_store->GetPositions();
 
-    for(int x = 0; x < m_particleLength; ++x)
+    // Vertices of regions surrounded by sleep keep their last smoothing and normal
+    for(int index = 0; index < m_particleCount; ++index)
     {
-        for(int y = 0; y < m_particleLength; ++y)
+        if(!m_sleep->IsSettled(m_sleep->GetRegion(index)))
         {
-            index = (x*m_particleLength)+y;
             m_vertexData[index].normal = normal;
-            m_vertexData[index].uvs = m_particles[index]->GetUVs();
-            m_vertexData[index].position = m_particles[index]->GetPosition();
+            m_vertexData[index].position = m_previousState[index] + 
+                ((positions[index] - m_previousState[index]) * m_interpolation);
         }
     }
 }
 
 void Cloth::UpdateNormals()
 {
-    D3DXVECTOR3 normal;
-    int p1, p2, p3, p4;
+    // Each triangle normal is found once then gathered by the particles using it
+    const std::vector<int>& triangles = m_topology->GetTriangles();
+    for(unsigned int i = 0; i < m_faceNormals.size(); ++i)
+    {
+        const int* points = &triangles[i * POINTS_IN_FACE];
+        m_faceNormals[i] = CalculateNormal(m_vertexData[points[0]].position,
+            m_vertexData[points[1]].position, m_vertexData[points[2]].position);
+    }
 
-    for(int x = 0; x < m_particleLength-1; ++x)
+    const std::vector<int>& start = m_topology->GetTriangleStart();
+    const std::vector<int>& particleTriangles = m_topology->GetParticleTriangles();
+    for(int index = 0; index < m_particleCount; ++index)
     {
-        for(int y = 0; y < m_particleLength-1; ++y)
+        if(!m_sleep->IsSettled(m_sleep->GetRegion(index)))
         {
-            p1 = (x*m_particleLength)+y;
-            p2 = ((x+1)*m_particleLength)+y;
-            p3 = (x*m_particleLength)+y+1;
-            p4 = ((x+1)*m_particleLength)+y+1;
-
-            normal = CalculateNormal(m_vertexData[p2].position,
-                m_vertexData[p1].position, m_vertexData[p3].position);
-
-            m_vertexData[p2].normal += normal;
-            m_vertexData[p1].normal += normal;
-            m_vertexData[p3].normal += normal;
-
-            normal = CalculateNormal(m_vertexData[p4].position,
-                m_vertexData[p2].position, m_vertexData[p3].position);
-
-            m_vertexData[p4].normal += normal;
-            m_vertexData[p2].normal += normal;
-            m_vertexData[p3].normal += normal;
+            for(int i = start[index]; i < start[index+1]; ++i)
+            {
+                m_vertexData[index].normal += m_faceNormals[particleTriangles[i]];
+            }
         }
     }
 }
@@ -732,32 +1748,55 @@ void Cloth::SmoothCloth()
 {
     if(m_generalSmoothing > 0.0f)
     {
-        int index = NO_INDEX;
-        D3DXVECTOR3 halfp1, halfp2;
-        D3DXVECTOR3 positionDifference;
         D3DXVECTOR3 smoothedPosition;
-        int p1, p2, p3, p4;
+        auto requiresSmoothing = [this](int index) -> bool
+        {
+            return !m_store->HasFlag(index, ParticleStore::HULL_CONTACT) &&
+                !m_sleep->IsSettled(m_sleep->GetRegion(index));
+        };
 
-        for(int x = 1; x < m_particleLength-1; ++x)
+        if(m_particleLength > 0)
         {
-            for(int y = 1; y < m_particleLength-1; ++y)
+            // The grid averages its four diagonal neighbours so the smoothing
+            // does not follow the direction the quads are triangulated in
+            for(int x = 1; x < m_particleLength-1; ++x)
             {
-                index = (x*m_particleLength)+y;
-                if(m_particles[index]->RequiresSmoothing())
+                for(int y = 1; y < m_particleLength-1; ++y)
                 {
-                    p1 = ((x+1)*m_particleLength)+y+1;
-                    p2 = ((x+1)*m_particleLength)+y-1;
-                    p3 = ((x-1)*m_particleLength)+y+1;
-                    p4 = ((x-1)*m_particleLength)+y-1;
-
-                    halfp1 = (m_vertexData[p1].position
-                        + m_vertexData[p4].position) * 0.5f;
-
-                    halfp2 = (m_vertexData[p2].position
-                        + m_vertexData[p3].position) * 0.5f;
+                    const int index = m_layout->GetParticle(x, y);
+                    if(requiresSmoothing(index))
+                    {
+                        smoothedPosition = (m_vertexData[m_layout->GetParticle(x+1, y+1)].position
+                            + m_vertexData[m_layout->GetParticle(x+1, y-1)].position
+                            + m_vertexData[m_layout->GetParticle(x-1, y+1)].position
+                            + m_vertexData[m_layout->GetParticle(x-1, y-1)].position) * 0.25f;
+
+                        const D3DXVECTOR3 positionDifference = smoothedPosition - m_vertexData[index].position;
+                        m_vertexData[index].position += positionDifference * m_generalSmoothing;
+                    }
+                }
+            }
+        }
+        else
+        {
+            // Imported meshes average every particle sharing an edge
+            const std::vector<int>& start = m_topology->GetNeighbourStart();
+            const std::vector<int>& neighbours = m_topology->GetNeighbours();
 
-                    smoothedPosition = (halfp1 + halfp2) * 0.5f;
-                    positionDifference = smoothedPosition - m_vertexData[index].position;
+            for(int index = 0; index < m_particleCount; ++index)
+            {
+                if(!m_topology->IsBoundary(index) && 
+                   requiresSmoothing(index) &&
+                   start[index+1] > start[index])
+                {
+                    smoothedPosition = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+                    for(int i = start[index]; i < start[index+1]; ++i)
+                    {
+                        smoothedPosition += m_vertexData[neighbours[i]].position;
+                    }
+                    smoothedPosition /= static_cast<float>(start[index+1] - start[index]);
+
+                    const D3DXVECTOR3 positionDifference = smoothedPosition - m_vertexData[index].position;
                     m_vertexData[index].position += positionDifference * m_generalSmoothing;
                 }
             }
@@ -779,10 +1818,10 @@ void Cloth::UpdateSubdividedVertices()
         {
             for(int y = 0; y < m_particleLength-1; ++y)
             {
-                p1 = (x*m_particleLength)+y;
-                p2 = ((x+1)*m_particleLength)+y;
-                p3 = (x*m_particleLength)+y+1;
-                p4 = ((x+1)*m_particleLength)+y+1;
+                p1 = m_layout->GetParticle(x, y);
+                p2 = m_layout->GetParticle(x+1, y);
+                p3 = m_layout->GetParticle(x, y+1);
+                p4 = m_layout->GetParticle(x+1, y+1);
                 quadindex = m_particleCount + quad;
 
                 halfp1 = (m_vertexData[p1].position
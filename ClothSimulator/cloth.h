@@ -7,11 +7,25 @@
 #include "callbacks.h"
 #include "pickablemesh.h"
 #include "geometry.h"
+#include "spring.h"
+#include "gridlayout.h"
 
 class Picking;
 class CollisionMesh;
 class Particle;
-class Spring;
+class ParticleStore;
+class ThreadPool;
+class SpringKernel;
+struct PackedSprings;
+class JacobiSolver;
+class ImplicitSolver;
+class MultigridSolver;
+class StencilSolver;
+class AttachmentConstraints;
+class MembraneSolver;
+class ChebyshevAccelerator;
+class ClothTopology;
+class SleepRegions;
 
 /**
 * Dynamic mesh with soft body physics
@@ -21,7 +35,29 @@ class Cloth : public PickableMesh, public Transform
 public:
 
     typedef std::unique_ptr<Particle> ParticlePtr;
-    typedef std::unique_ptr<Spring> SpringPtr;
+
+    /**
+    * Methods available to solve the springs
+    */
+    enum Solver
+    {
+        GAUSS_SEIDEL,  ///< Springs corrected in sequence by independent batch
+        JACOBI,        ///< Spring corrections averaged and applied together
+        XPBD,          ///< Compliant springs solved in batches over substeps
+        MULTIGRID,     ///< Batches smoothed between corrections from coarser grids
+        STENCIL,       ///< Grid springs found from fixed offsets without per-spring data
+        MAX_SOLVERS
+    };
+
+    /**
+    * Methods available to move the particles forward in time
+    */
+    enum Integrator
+    {
+        VERLET,         ///< Explicit integration followed by the spring solver
+        IMPLICIT_EULER, ///< Backward Euler step solving all spring forces together
+        MAX_INTEGRATORS
+    };
 
     /**
     * Constructor; loads the cloth mesh
@@ -71,7 +107,7 @@ public:
     /**
     * @param simulating Set whether the cloth is simulating
     */
-    void SetSimulation(bool simulating) { m_simulation = simulating; }
+    void SetSimulation(bool simulating);
 
     /**
     * @return whether the cloth is simulating
@@ -96,10 +132,18 @@ public:
     void SetVertexRows(double number);
 
     /**
-    * @return the amount of vertex rows for the cloth
+    * @return the amount of vertex rows for the cloth or zero for a mesh cloth
     */
     double GetVertexRows() const;
 
+    /**
+    * Recreates the cloth from the triangles of a model
+    * @note setting the rows or spacing returns to a grid cloth
+    * @param path The path to the model to load
+    * @return whether the model was loaded successfully
+    */
+    bool LoadMesh(const std::string& path);
+
     /**
     * Sets the particle solver iteration amount
     * @param iterations The iterations to set to
@@ -111,6 +155,222 @@ public:
     */
     double GetIterations() const;
 
+    /**
+    * Sets the method used to solve the springs
+    * @param solver The solver to use
+    */
+    void SetSolver(Solver solver);
+
+    /**
+    * @return the method used to solve the springs
+    */
+    Solver GetSolver() const { return m_solver; }
+
+    /**
+    * Switches to the next method available to solve the springs
+    */
+    void ToggleSolver();
+
+    /**
+    * @param solver The solver to get the name for
+    * @return the name of the solver
+    */
+    static std::string GetSolverName(Solver solver);
+
+    /**
+    * @param accelerate Whether to use Chebyshev acceleration for the Jacobi solver
+    */
+    void SetAcceleration(bool accelerate);
+
+    /**
+    * @return whether Chebyshev acceleration is used for the Jacobi solver
+    */
+    bool IsAccelerated() const { return m_accelerate; }
+
+    /**
+    * Toggles Chebyshev acceleration for the Jacobi solver
+    */
+    void ToggleAcceleration();
+
+    /**
+    * @return the Chebyshev acceleration for the spring solver iterations
+    */
+    ChebyshevAccelerator& GetAccelerator();
+
+    /**
+    * @param allow Whether regions of the cloth at rest are put to sleep
+    */
+    void SetSleepingAllowed(bool allow);
+
+    /**
+    * @return whether regions of the cloth at rest are put to sleep
+    */
+    bool IsSleepingAllowed() const { return m_allowSleeping; }
+
+    /**
+    * Toggles whether regions of the cloth at rest are put to sleep
+    */
+    void ToggleSleeping();
+
+    /**
+    * @return whether any region of the cloth is asleep
+    */
+    bool HasSleepingRegions() const;
+
+    /**
+    * @param solve Whether the bend springs are solved; without them the cloth
+    *        folds more freely but each iteration is cheaper for distant cloth
+    */
+    void SetBendSprings(bool solve);
+
+    /**
+    * @return whether the bend springs are solved
+    */
+    bool IsSolvingBendSprings() const { return m_bendSprings; }
+
+    /**
+    * Toggles whether the bend springs are solved
+    */
+    void ToggleBendSprings();
+
+    /**
+    * @param attach Whether free particles are kept within their rest distance
+    *        over the cloth of the nearest pinned particle
+    */
+    void SetAttachments(bool attach);
+
+    /**
+    * @return whether free particles are kept within reach of the nearest pinned particle
+    */
+    bool IsAttaching() const { return m_attach; }
+
+    /**
+    * Toggles whether free particles are kept within reach of the nearest pinned particle
+    */
+    void ToggleAttachments();
+
+    /**
+    * @param solve Whether a finite element membrane over the triangles is solved in place 
+    *        of the stretch and shear springs by the Gauss-Seidel, XPBD and multigrid solvers
+    */
+    void SetMembrane(bool solve);
+
+    /**
+    * @return whether the membrane is solved in place of the stretch and shear springs
+    */
+    bool IsSolvingMembrane() const { return m_solveMembrane; }
+
+    /**
+    * Toggles whether the membrane is solved in place of the stretch and shear springs
+    */
+    void ToggleMembrane();
+
+    /**
+    * @param limit Whether the stretch and shear springs are moved back 
+    *        within the strain limits after the springs are solved
+    */
+    void SetStrainLimiting(bool limit);
+
+    /**
+    * @return whether the stretch of the springs is limited after solving
+    */
+    bool IsLimitingStrain() const { return m_limitStrain; }
+
+    /**
+    * Toggles whether the stretch of the springs is limited after solving
+    */
+    void ToggleStrainLimiting();
+
+    /**
+    * @param minStretch The shortest spring length as a ratio of its rest; at most one
+    * @param maxStretch The longest spring length as a ratio of its rest; at least one
+    */
+    void SetStrainLimits(float minStretch, float maxStretch);
+
+    /**
+    * @return the shortest spring length as a ratio of its rest when limiting
+    */
+    float GetMinStretch() const { return m_minStretch; }
+
+    /**
+    * @return the longest spring length as a ratio of its rest when limiting
+    */
+    float GetMaxStretch() const { return m_maxStretch; }
+
+    /**
+    * Sets the order the particles of a grid cloth are stored in and rebuilds the grid
+    * @param order The order to store the particles in
+    */
+    void SetLayout(GridLayout::Order order);
+
+    /**
+    * @return the order the particles of a grid cloth are stored in
+    */
+    GridLayout::Order GetLayout() const { return m_layoutOrder; }
+
+    /**
+    * Switches to the next order to store the particles of a grid cloth in
+    */
+    void ToggleLayout();
+
+    /**
+    * Sets the compliance used by the XPBD solver for a type of spring
+    * @param type The type of spring to set
+    * @param compliance The inverse stiffness; zero is rigid
+    */
+    void SetCompliance(Spring::Type type, float compliance);
+
+    /**
+    * @param type The type of spring to get
+    * @return the compliance used by the XPBD solver for the type of spring
+    */
+    float GetCompliance(Spring::Type type) const;
+
+    /**
+    * Sets the method used to move the particles forward in time
+    * @param integrator The integrator to use
+    */
+    void SetIntegrator(Integrator integrator) { m_integrator = integrator; }
+
+    /**
+    * @return the method used to move the particles forward in time
+    */
+    Integrator GetIntegrator() const { return m_integrator; }
+
+    /**
+    * Switches to the next method available to move the particles
+    */
+    void ToggleIntegrator();
+
+    /**
+    * @param integrator The integrator to get the name for
+    * @return the name of the integrator
+    */
+    static std::string GetIntegratorName(Integrator integrator);
+
+    /**
+    * Sets the stiffness used by the implicit integrator for a type of spring
+    * @param type The type of spring to set
+    * @param stiffness The stiffness of the spring
+    */
+    void SetStiffness(Spring::Type type, float stiffness);
+
+    /**
+    * @param type The type of spring to get
+    * @return the stiffness used by the implicit integrator for the type of spring
+    */
+    float GetStiffness(Spring::Type type) const;
+
+    /**
+    * @param substeps The number of substeps per tick for the XPBD solver
+    */
+    void SetSubsteps(int substeps);
+
+    /**
+    * @return the number of substeps per tick for the XPBD solver
+    */
+    int GetSubsteps() const { return m_substeps; }
+
     /**
     * Sets the cloth timestep
     * @param timestep The timestep to set to
@@ -126,6 +386,46 @@ public:
     * @return the container of cloth particles
     */
     std::vector<ParticlePtr>& GetParticles();
+
+    /**
+    * @return the simulated state of the cloth particles
+    */
+    ParticleStore& GetParticleStore();
+
+    /**
+    * Moves the particle collision meshes to any new particle positions
+    */
+    void UpdateCollisionPositions();
+
+    /**
+    * Solves all springs, running each independent batch in parallel
+    */
+    void SolveSprings();
+
+    /**
+    * @return the kernel used to solve the springs
+    */
+    SpringKernel& GetSpringKernel();
+
+    /**
+    * @return the number of springs in the cloth
+    */
+    int GetSpringCount() const { return m_springCount; }
+
+    /**
+    * @return the number of triangles in the membrane
+    */
+    int GetMembraneTriangleCount() const;
+
+    /**
+    * @return the root mean square of each spring's stretch relative to its rest distance
+    */
+    double GetSpringResidual() const;
+
+    /**
+    * @return the largest stretch or compression of any stretch or shear spring relative to its rest distance
+    */
+    double GetMaxStrain() const;
     
     /**
     * @param draw Set whether the vertices are visible or not
@@ -182,8 +482,19 @@ public:
     */
     void PostCollisionUpdate();
 
+    /**
+    * Updates the rendered cloth between the last two simulated states
+    * @param interpolation The fraction from the previous to the current state
+    */
+    void UpdateRenderState(float interpolation);
+
 private:
 
+    /**
+    * Keeps the current particle positions as the previous simulated state
+    */
+    void SavePreviousState();
+
     /**
     * Recreates the cloth
     * @param rows The number of rows for the cloth
@@ -191,6 +502,119 @@ private:
     */
     void CreateCloth(int rows, float spacing);
 
+    /**
+    * Recreates the cloth from a triangle mesh
+    * @param positions The position of each particle
+    * @param uvs The texture coordinates of each particle
+    * @param triangles Three particle indices for each triangle
+    */
+    void CreateCloth(const std::vector<D3DXVECTOR3>& positions,
+        const std::vector<D3DXVECTOR2>& uvs, const std::vector<DWORD>& triangles);
+
+    /**
+    * Creates or reinitialises the particles of the cloth
+    * @param positions The position of each particle
+    * @param uvs The texture coordinates of each particle
+    * @param diagnosticParticle The particle to render diagnostics for
+    */
+    void CreateParticles(const std::vector<D3DXVECTOR3>& positions,
+        const std::vector<D3DXVECTOR2>& uvs, int diagnosticParticle);
+
+    /**
+    * Creates the DirectX mesh from the vertex and index data
+    */
+    void CreateMesh();
+
+    /**
+    * Scales the existing cloth in place to a new spacing
+    * @param spacing The spacing between vertices
+    */
+    void RescaleCloth(float spacing);
+
+    /**
+    * Removes all springs ready for a new cloth
+    * @param count The number of springs the new cloth will have
+    */
+    void ClearSprings(int count);
+
+    /**
+    * Adds a spring at rest between two particles
+    * @param index1/index2 The indices of the two particles connected by the spring
+    * @param type The type of spring created
+    */
+    void AddSpring(int index1, int index2, Spring::Type type);
+
+    /**
+    * Partitions the springs into batches where no two springs share a particle
+    * @note springs are reordered so each batch is contiguous
+    */
+    void PartitionSprings();
+
+    /**
+    * Updates how each spring correction is shared between its particles
+    * depending on the velocity of any meshes they are interacting with
+    */
+    void UpdateSpringWeights();
+
+    /**
+    * @return whether any particle is interacting with a moving mesh
+    */
+    bool HasInteractingParticles() const;
+
+    /**
+    * Finds the runs of springs in each batch which are not inside a sleeping region
+    */
+    void UpdateActiveSprings();
+
+    /**
+    * Wakes all regions of the cloth
+    */
+    void WakeRegions();
+
+    /**
+    * Solves one iteration of the membrane then all spring batches in sequence
+    */
+    void SolveSpringBatches();
+
+    /**
+    * Limits the distance of free particles from the nearest pinned particle
+    */
+    void SolveAttachments();
+
+    /**
+    * Moves the stretch and shear springs back within the strain limits
+    */
+    void LimitStrain();
+
+    /**
+    * Solves one iteration of all spring batches with each type of spring in turn
+    * @tparam Bend Whether bend springs are solved or compiled out
+    * @tparam Interacting Whether corrections are shared by the packed weights rather than equally
+    * @tparam Limit Whether springs are only moved back within the strain limits
+    */
+    template<bool Bend, bool Interacting, bool Limit>
+    void SolveSpringTypes();
+
+    /**
+    * Solves the active runs of one type of spring within a batch
+    * @tparam Type The type of spring to solve
+    * @tparam Interacting Whether corrections are shared by the packed weights rather than equally
+    * @tparam Limit Whether springs are only moved back within the strain limits
+    * @param batch The batch to solve
+    */
+    template<Spring::Type Type, bool Interacting, bool Limit>
+    void SolveSpringRuns(int batch);
+
+    /**
+    * Solves a contiguous range of springs of one type
+    * @tparam Type The type of every spring in the range
+    * @tparam Interacting Whether corrections are shared by the packed weights rather than equally
+    * @tparam Limit Whether springs are only moved back within the strain limits
+    * @param begin/end The range of springs to solve
+    */
+    template<Spring::Type Type, bool Interacting, bool Limit>
+    void SolveSpringRange(int begin, int end);
+
     /**
     * Draws and updates the diagnostics for the cloth
     */
@@ -236,9 +660,9 @@ private:
 
     /**
     * @param row/column The row and column of the required particle
-    * @return the particle in grid at row/col
+    * @return the index of the particle in grid at row/col
     */
-    ParticlePtr& GetParticle(int row, int column);
+    int GetParticleIndex(int row, int column) const;
 
     /**
     * Creates a normal from the given three particles
@@ -272,7 +696,7 @@ private:
     float m_damping;            ///< Damping to apply to movement of particles
     int m_springCount;          ///< Number of springs in cloth
     int m_springIterations;     ///< Number of solver iterations per tick
-    int m_particleLength;       ///< Number of particles in a row/column
+    int m_particleLength;       ///< Number of particles in a row/column or zero for a mesh cloth
     int m_particleCount;        ///< Overall number of particles in the cloth
     int m_quadVertices;         ///< Number of vertices that center each quad
     bool m_simulation;          ///< Whether the cloth is currently simulating
@@ -287,12 +711,50 @@ private:
 
     EnginePtr m_engine;                           ///< Callbacks for the rendering engine
     std::vector<D3DXVECTOR3> m_colors;            ///< Viable colors for the particles
-    std::vector<SpringPtr> m_springs;             ///< Springs connecting particles together
+    std::vector<Spring> m_springs;                ///< Type and diagnostic data for each packed spring
+    std::vector<int> m_regionSprings;             ///< Start of each region's springs for each type within each independent batch
+    std::vector<std::pair<int, int>> m_activeSpringRuns; ///< Ranges of springs outside sleeping regions
+    std::vector<int> m_activeBatches;             ///< Start of the active spring runs for each type within each batch
+    bool m_bendSprings;                           ///< Whether the bend springs are solved
+    std::unique_ptr<SleepRegions> m_sleep;        ///< Regions of the cloth put to sleep when at rest
+    bool m_allowSleeping;                         ///< Whether regions at rest are put to sleep
+    std::unique_ptr<ThreadPool> m_threads;        ///< Threads to solve the spring batches
+    std::unique_ptr<PackedSprings> m_packedSprings; ///< Spring data packed for the spring kernel
+    std::unique_ptr<SpringKernel> m_springKernel; ///< Vectorized solver for the springs
+    bool m_uniformSpringWeights;                  ///< Whether all springs share corrections equally
+    std::unique_ptr<JacobiSolver> m_jacobi;       ///< Solver for averaging spring corrections
+    Solver m_solver;                              ///< Method used to solve the springs
+    int m_substeps;                               ///< Substeps per tick for the XPBD solver
+    float m_compliance[Spring::MAX_TYPES];        ///< XPBD compliance for each type of spring
+    std::unique_ptr<ImplicitSolver> m_implicit;   ///< Backward Euler integrator for the particles
+    std::unique_ptr<MultigridSolver> m_multigrid; ///< Solver for correcting springs over coarser grids
+    std::unique_ptr<StencilSolver> m_stencil;     ///< Solver for the springs of a regular grid
+    std::unique_ptr<AttachmentConstraints> m_attachments; ///< Limits on the distance of free particles from the pins
+    bool m_attach;                                ///< Whether the attachments to the pins are solved
+    std::unique_ptr<MembraneSolver> m_membrane;   ///< Finite element membrane over the cloth triangles
+    bool m_solveMembrane;                         ///< Whether the membrane replaces the stretch and shear springs
+    bool m_limitStrain;                           ///< Whether the stretch of the springs is limited after solving
+    float m_minStretch;                           ///< Shortest spring length as a ratio of its rest when limiting
+    float m_maxStretch;                           ///< Longest spring length as a ratio of its rest when limiting
+    std::unique_ptr<ChebyshevAccelerator> m_accelerator; ///< Extrapolation over the spring solver iterations
+    bool m_accelerate;                            ///< Whether to accelerate the spring solver iterations
+    bool m_estimateRadius;                        ///< Whether the accelerator needs a new spectral radius
+    Integrator m_integrator;                      ///< Method used to move the particles
+    float m_stiffness[Spring::MAX_TYPES];         ///< Implicit stiffness for each type of spring
+    std::vector<float> m_springLambda;            ///< XPBD Lagrange multiplier for each spring
+    std::unique_ptr<ParticleStore> m_store;       ///< Simulated state of the particles
     std::vector<ParticlePtr> m_particles;         ///< Particles across the cloth grid
+    std::vector<ParticlePtr> m_spareParticles;    ///< Particles kept from a larger cloth for reuse
     std::vector<MeshVertex> m_vertexData;         ///< DirectX Vertex data
+    std::vector<D3DXVECTOR3> m_previousState;     ///< Particle positions at the start of the last tick
+    float m_interpolation;                        ///< Fraction from the previous to the current state to render
     std::vector<DWORD> m_indexData;               ///< DirectX Index data
+    std::unique_ptr<ClothTopology> m_topology;    ///< Edge and triangle connectivity of the particles
+    std::vector<D3DXVECTOR3> m_faceNormals;       ///< Normal of each triangle of the topology
     std::shared_ptr<CollisionMesh> m_template;    ///< Template collision for all particles
     LPD3DXMESH m_mesh;                            ///< Directx geometry mesh
     LPDIRECT3DTEXTURE9 m_texture;                 ///< The texture attached to the mesh
     LPD3DXEFFECT m_shader;                        ///< The shader attached to the mesh
+    std::unique_ptr<GridLayout> m_layout;         ///< Mapping of the grid rows and columns to particles
+    GridLayout::Order m_layoutOrder;              ///< Order to store the particles of a grid cloth in
 };
\ No newline at end of file
@@ -0,0 +1,274 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - clothtopology.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "clothtopology.h"
+#include <algorithm>
+
+namespace
+{
+    /**
+    * Half of an edge found while walking each triangle
+    */
+    struct HalfEdge
+    {
+        int index1;     ///< Lowest particle index of the edge
+        int index2;     ///< Highest particle index of the edge
+        int opposite;   ///< Particle opposite the edge in its triangle
+
+        bool operator<(const HalfEdge& edge) const
+        {
+            return index1 != edge.index1 ? index1 < edge.index1 : index2 < edge.index2;
+        }
+    };
+
+    /**
+    * Fills a start offset array from a count for each element
+    * @param counts The count for each element, turned into the start offsets
+    * @return the total count across all elements
+    */
+    int AccumulateCounts(std::vector<int>& counts)
+    {
+        int total = 0;
+        for(int& count : counts)
+        {
+            const int start = total;
+            total += count;
+            count = start;
+        }
+        counts.push_back(total);
+        return total;
+    }
+
+    /**
+    * Rebuilds the vertex arrays in a new order
+    * @param order The old index of the vertex at each new position
+    */
+    void ApplyOrder(const std::vector<int>& order,
+                    std::vector<D3DXVECTOR3>& positions,
+                    std::vector<D3DXVECTOR2>& uvs,
+                    std::vector<DWORD>& triangles)
+    {
+        std::vector<D3DXVECTOR3> orderedPositions(order.size());
+        std::vector<D3DXVECTOR2> orderedUvs(order.size());
+        std::vector<DWORD> newIndex(positions.size());
+
+        for(unsigned int i = 0; i < order.size(); ++i)
+        {
+            orderedPositions[i] = positions[order[i]];
+            orderedUvs[i] = uvs[order[i]];
+            newIndex[order[i]] = i;
+        }
+
+        for(DWORD& index : triangles)
+        {
+            index = newIndex[index];
+        }
+
+        positions.swap(orderedPositions);
+        uvs.swap(orderedUvs);
+    }
+}
+
+ClothTopology::ClothTopology()
+{
+}
+
+void ClothTopology::Initialise(int particleCount, const std::vector<DWORD>& triangles)
+{
+    m_triangles.assign(triangles.begin(), triangles.end());
+    const int triangleCount = static_cast<int>(m_triangles.size()) / POINTS_IN_FACE;
+
+    // Edges are found by sorting the three half edges of every triangle
+    // so the triangles sharing an edge end up next to each other
+    std::vector<HalfEdge> halfEdges;
+    halfEdges.reserve(m_triangles.size());
+    for(int i = 0; i < triangleCount; ++i)
+    {
+        const int* points = &m_triangles[i * POINTS_IN_FACE];
+        for(int j = 0; j < POINTS_IN_FACE; ++j)
+        {
+            const int index1 = points[j];
+            const int index2 = points[(j+1) % POINTS_IN_FACE];
+            const int opposite = points[(j+2) % POINTS_IN_FACE];
+            halfEdges.push_back({ min(index1, index2), max(index1, index2), opposite });
+        }
+    }
+    std::sort(halfEdges.begin(), halfEdges.end());
+
+    // Edges shared by more than two triangles only keep the first two
+    m_edges.clear();
+    for(unsigned int i = 0; i < halfEdges.size(); ++i)
+    {
+        const HalfEdge& halfEdge = halfEdges[i];
+        if(!m_edges.empty() &&
+            m_edges.back().index1 == halfEdge.index1 &&
+            m_edges.back().index2 == halfEdge.index2)
+        {
+            if(m_edges.back().opposite2 == NO_INDEX)
+            {
+                m_edges.back().opposite2 = halfEdge.opposite;
+            }
+            continue;
+        }
+        m_edges.push_back({ halfEdge.index1, halfEdge.index2, halfEdge.opposite, NO_INDEX });
+    }
+
+    m_boundary.assign(particleCount, 0);
+    m_neighbourStart.assign(particleCount, 0);
+    for(const Edge& edge : m_edges)
+    {
+        ++m_neighbourStart[edge.index1];
+        ++m_neighbourStart[edge.index2];
+        if(edge.opposite2 == NO_INDEX)
+        {
+            m_boundary[edge.index1] = 1;
+            m_boundary[edge.index2] = 1;
+        }
+    }
+
+    m_neighbours.resize(AccumulateCounts(m_neighbourStart));
+    std::vector<int> next(m_neighbourStart.begin(), m_neighbourStart.end()-1);
+    for(const Edge& edge : m_edges)
+    {
+        m_neighbours[next[edge.index1]++] = edge.index2;
+        m_neighbours[next[edge.index2]++] = edge.index1;
+    }
+
+    m_triangleStart.assign(particleCount, 0);
+    for(int index : m_triangles)
+    {
+        ++m_triangleStart[index];
+    }
+
+    m_particleTriangles.resize(AccumulateCounts(m_triangleStart));
+    next.assign(m_triangleStart.begin(), m_triangleStart.end()-1);
+    for(int i = 0; i < triangleCount; ++i)
+    {
+        for(int j = 0; j < POINTS_IN_FACE; ++j)
+        {
+            m_particleTriangles[next[m_triangles[i * POINTS_IN_FACE + j]]++] = i;
+        }
+    }
+}
+
+void ClothTopology::WeldVertices(std::vector<D3DXVECTOR3>& positions,
+                                 std::vector<D3DXVECTOR2>& uvs,
+                                 std::vector<DWORD>& triangles)
+{
+    std::vector<int> sorted(positions.size());
+    for(unsigned int i = 0; i < sorted.size(); ++i)
+    {
+        sorted[i] = i;
+    }
+
+    auto isLess = [&](int a, int b)
+    {
+        const D3DXVECTOR3& p1 = positions[a];
+        const D3DXVECTOR3& p2 = positions[b];
+        return p1.x != p2.x ? p1.x < p2.x : (p1.y != p2.y ? p1.y < p2.y : p1.z < p2.z);
+    };
+    std::stable_sort(sorted.begin(), sorted.end(), isLess);
+
+    // Each run of equal positions keeps the vertex found first
+    std::vector<int> order;
+    std::vector<DWORD> newIndex(positions.size());
+    for(unsigned int i = 0; i < sorted.size(); ++i)
+    {
+        if(i == 0 || isLess(sorted[i-1], sorted[i]))
+        {
+            order.push_back(sorted[i]);
+        }
+        newIndex[sorted[i]] = static_cast<DWORD>(order.size()-1);
+    }
+
+    if(order.size() == positions.size())
+    {
+        return;
+    }
+
+    // Triangles collapsed by the weld are removed
+    std::vector<DWORD> welded;
+    welded.reserve(triangles.size());
+    for(unsigned int i = 0; i+2 < triangles.size(); i += POINTS_IN_FACE)
+    {
+        const DWORD index1 = newIndex[triangles[i]];
+        const DWORD index2 = newIndex[triangles[i+1]];
+        const DWORD index3 = newIndex[triangles[i+2]];
+        if(index1 != index2 && index2 != index3 && index1 != index3)
+        {
+            welded.push_back(index1);
+            welded.push_back(index2);
+            welded.push_back(index3);
+        }
+    }
+    triangles.swap(welded);
+
+    std::vector<D3DXVECTOR3> weldedPositions(order.size());
+    std::vector<D3DXVECTOR2> weldedUvs(order.size());
+    for(unsigned int i = 0; i < order.size(); ++i)
+    {
+        weldedPositions[i] = positions[order[i]];
+        weldedUvs[i] = uvs[order[i]];
+    }
+    positions.swap(weldedPositions);
+    uvs.swap(weldedUvs);
+}
+
+void ClothTopology::OrderVertices(std::vector<D3DXVECTOR3>& positions,
+                                  std::vector<D3DXVECTOR2>& uvs,
+                                  std::vector<DWORD>& triangles)
+{
+    const int count = static_cast<int>(positions.size());
+    ClothTopology topology;
+    topology.Initialise(count, triangles);
+
+    const std::vector<int>& start = topology.GetNeighbourStart();
+    const std::vector<int>& neighbours = topology.GetNeighbours();
+    auto getDegree = [&](int index) { return start[index+1] - start[index]; };
+
+    std::vector<int> byDegree(count);
+    for(int i = 0; i < count; ++i)
+    {
+        byDegree[i] = i;
+    }
+    std::stable_sort(byDegree.begin(), byDegree.end(),
+        [&](int a, int b) { return getDegree(a) < getDegree(b); });
+
+    // Breadth first from the least connected vertex of each piece,
+    // visiting the neighbours of each vertex from least connected
+    std::vector<int> order;
+    order.reserve(count);
+    std::vector<unsigned char> visited(count, 0);
+    std::vector<int> adjacent;
+
+    for(int seed : byDegree)
+    {
+        if(visited[seed])
+        {
+            continue;
+        }
+
+        visited[seed] = 1;
+        order.push_back(seed);
+        for(unsigned int i = order.size()-1; i < order.size(); ++i)
+        {
+            const int index = order[i];
+            adjacent.assign(neighbours.begin() + start[index], neighbours.begin() + start[index+1]);
+            std::stable_sort(adjacent.begin(), adjacent.end(),
+                [&](int a, int b) { return getDegree(a) < getDegree(b); });
+
+            for(int neighbour : adjacent)
+            {
+                if(!visited[neighbour])
+                {
+                    visited[neighbour] = 1;
+                    order.push_back(neighbour);
+                }
+            }
+        }
+    }
+
+    std::reverse(order.begin(), order.end());
+    ApplyOrder(order, positions, uvs, triangles);
+}
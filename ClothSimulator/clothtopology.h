@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - clothtopology.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+
+/**
+* Edge and triangle connectivity of the cloth particles
+* Per-particle connections are stored as a start offset into a shared array
+*/
+class ClothTopology
+{
+public:
+
+    /**
+    * Edge shared by one or two triangles
+    */
+    struct Edge
+    {
+        int index1;     ///< Index of the first particle of the edge
+        int index2;     ///< Index of the second particle of the edge
+        int opposite1;  ///< Particle opposite the edge in the first triangle
+        int opposite2;  ///< Particle opposite the edge in the second triangle or NO_INDEX
+    };
+
+    /**
+    * Constructor
+    */
+    ClothTopology();
+
+    /**
+    * Builds the connectivity from a triangle list
+    * @param particleCount The number of particles
+    * @param triangles Three particle indices for each triangle
+    */
+    void Initialise(int particleCount, const std::vector<DWORD>& triangles);
+
+    /**
+    * @return the unique edges across all triangles
+    */
+    const std::vector<Edge>& GetEdges() const { return m_edges; }
+
+    /**
+    * @return three particle indices for each triangle
+    */
+    const std::vector<int>& GetTriangles() const { return m_triangles; }
+
+    /**
+    * @return the start of each particle's neighbours with one past the last particle at the end
+    */
+    const std::vector<int>& GetNeighbourStart() const { return m_neighbourStart; }
+
+    /**
+    * @return the particles sharing an edge with each particle
+    */
+    const std::vector<int>& GetNeighbours() const { return m_neighbours; }
+
+    /**
+    * @return the start of each particle's triangles with one past the last particle at the end
+    */
+    const std::vector<int>& GetTriangleStart() const { return m_triangleStart; }
+
+    /**
+    * @return the triangles using each particle
+    */
+    const std::vector<int>& GetParticleTriangles() const { return m_particleTriangles; }
+
+    /**
+    * @param index The index of the particle
+    * @return whether the particle lies on an edge with only one triangle
+    */
+    bool IsBoundary(int index) const { return m_boundary[index] != 0; }
+
+    /**
+    * Merges vertices sharing the same position such as those split by
+    * texture seams so the cloth does not tear along them
+    * @note the first uv found is kept for each merged vertex
+    * @param positions The vertex positions
+    * @param uvs The vertex texture coordinates
+    * @param triangles Three vertex indices for each triangle
+    */
+    static void WeldVertices(std::vector<D3DXVECTOR3>& positions,
+        std::vector<D3DXVECTOR2>& uvs, std::vector<DWORD>& triangles);
+
+    /**
+    * Reorders the vertices with reverse Cuthill-McKee so connected
+    * vertices sit close together in memory like the regular grid
+    * @param positions The vertex positions
+    * @param uvs The vertex texture coordinates
+    * @param triangles Three vertex indices for each triangle
+    */
+    static void OrderVertices(std::vector<D3DXVECTOR3>& positions,
+        std::vector<D3DXVECTOR2>& uvs, std::vector<DWORD>& triangles);
+
+private:
+
+    /**
+    * Prevent copying
+    */
+    ClothTopology(const ClothTopology&) = delete;
+    ClothTopology& operator=(const ClothTopology&) = delete;
+
+    std::vector<Edge> m_edges;              ///< Unique edges across all triangles
+    std::vector<int> m_triangles;           ///< Three particle indices for each triangle
+    std::vector<int> m_neighbourStart;      ///< Start of each particle's neighbours
+    std::vector<int> m_neighbours;          ///< Particles sharing an edge with each particle
+    std::vector<int> m_triangleStart;       ///< Start of each particle's triangles
+    std::vector<int> m_particleTriangles;   ///< Triangles using each particle
+    std::vector<unsigned char> m_boundary;  ///< Whether each particle lies on a boundary edge
+};
@@ -59,6 +59,23 @@ void CollisionMesh::LoadCollisionModel(const D3DXVECTOR3& scale)
         bounds.x *= 2.0f;
         bounds.y *= 2.0f;
         break;
+    case Geometry::NONE:
+        if(!m_geometry->GetVertices().empty())
+        {
+            // Loaded hulls are not unit sized so are bounded 
+            // by their furthest vertex along each axis
+            D3DXVECTOR3 extent(0.0f, 0.0f, 0.0f);
+            for(const D3DXVECTOR3& vertex : m_geometry->GetVertices())
+            {
+                extent.x = max(extent.x, fabs(vertex.x));
+                extent.y = max(extent.y, fabs(vertex.y));
+                extent.z = max(extent.z, fabs(vertex.z));
+            }
+            bounds.x *= extent.x * 2.0f;
+            bounds.y *= extent.y * 2.0f;
+            bounds.z *= extent.z * 2.0f;
+        }
+        break;
     }
     CreateLocalBounds(bounds.x, bounds.y, bounds.z);
 
@@ -120,8 +137,12 @@ void CollisionMesh::Initialise(bool createmesh,
             shape, divisions));    
     }
 
+    // Primitives answer support queries from their transform so keep no vertices
     m_worldVertices.clear();
-    m_worldVertices.resize(m_geometry->GetVertices().size());
+    if(!IsPrimitive())
+    {
+        m_worldVertices.resize(m_geometry->GetVertices().size());
+    }
 
     D3DXVECTOR3 scale(minScale);
     if(m_parent)
@@ -134,6 +155,16 @@ void CollisionMesh::Initialise(bool createmesh,
     LoadCollisionModel(scale);
 }
 
+void CollisionMesh::Initialise(std::shared_ptr<Geometry> geometry,
+                               const D3DXVECTOR3& minScale, 
+                               const D3DXVECTOR3& maxScale)
+{
+    assert(geometry->GetShape() == Geometry::NONE);
+    assert(!geometry->GetVertices().empty());
+    m_geometry = geometry;
+    Initialise(false, Geometry::NONE, minScale, maxScale);
+}
+
 void CollisionMesh::LoadInstance(const CollisionMesh& mesh)
 {
     m_geometry = mesh.GetGeometry();
@@ -201,20 +232,132 @@ const std::vector<D3DXVECTOR3>& CollisionMesh::GetVertices() const
     return m_worldVertices;
 }
 
+bool CollisionMesh::IsPrimitive() const
+{
+    const Geometry::Shape shape = GetShape();
+    return shape == Geometry::SPHERE || 
+        shape == Geometry::BOX || 
+        shape == Geometry::CYLINDER;
+}
+
+D3DXVECTOR3 CollisionMesh::GetSupportPoint(const D3DXVECTOR3& direction, int& vertex) const
+{
+    // The world matrix rows map the unit shape into the world; the support of 
+    // the mapped shape is the mapped support of the unit shape along the 
+    // direction taken into the unit shape's axes
+    const D3DXVECTOR3 right(m_world.Right());
+    const D3DXVECTOR3 up(m_world.Up());
+    const D3DXVECTOR3 forward(m_world.Forward());
+    const D3DXVECTOR3 local(D3DXVec3Dot(&direction, &right),
+        D3DXVec3Dot(&direction, &up), D3DXVec3Dot(&direction, &forward));
+
+    D3DXVECTOR3 support(0.0f, 0.0f, 0.0f);
+    switch(GetShape())
+    {
+    case Geometry::SPHERE:
+        {
+            // Unit sphere of radius one
+            const float length = D3DXVec3Length(&local);
+            if(length > 0.0f)
+            {
+                support = local / length;
+            }
+        }
+        break;
+    case Geometry::BOX:
+        // Unit cube centered on the origin
+        support.x = local.x < 0.0f ? -0.5f : 0.5f;
+        support.y = local.y < 0.0f ? -0.5f : 0.5f;
+        support.z = local.z < 0.0f ? -0.5f : 0.5f;
+        break;
+    case Geometry::CYLINDER:
+        {
+            // Radius of one across x/y and a length of one along z
+            const float length = std::sqrt((local.x * local.x) + (local.y * local.y));
+            if(length > 0.0f)
+            {
+                support.x = local.x / length;
+                support.y = local.y / length;
+            }
+            support.z = local.z < 0.0f ? -0.5f : 0.5f;
+        }
+        break;
+    default:
+        return FindFurthestVertex(direction, vertex);
+    }
+
+    return m_position + (right * support.x) + (up * support.y) + (forward * support.z);
+}
+
+const D3DXVECTOR3& CollisionMesh::FindFurthestVertex(const D3DXVECTOR3& direction, int& vertex) const
+{
+    if(m_worldVertices.empty())
+    {
+        return m_position;
+    }
+
+    const std::vector<int>& neighbourStart = m_geometry->GetNeighbourStart();
+    const std::vector<int>& neighbours = m_geometry->GetNeighbours();
+
+    if(neighbourStart.empty())
+    {
+        // Without any faces every vertex is searched
+        vertex = 0;
+        float furthestDot = D3DXVec3Dot(&m_worldVertices[vertex], &direction);
+        for(unsigned int i = 1; i < m_worldVertices.size(); ++i)
+        {
+            float dot = D3DXVec3Dot(&m_worldVertices[i], &direction);
+            if(dot > furthestDot)
+            {
+                furthestDot = dot;
+                vertex = i;
+            }
+        }
+        return m_worldVertices[vertex];
+    }
+
+    // The last vertex may belong to a previous mesh at the same address
+    if(vertex < 0 || vertex >= static_cast<int>(m_worldVertices.size()))
+    {
+        vertex = 0;
+    }
+
+    float furthestDot = D3DXVec3Dot(&m_worldVertices[vertex], &direction);
+    int furthest = vertex;
+    do
+    {
+        vertex = furthest;
+        for(int i = neighbourStart[vertex]; i < neighbourStart[vertex+1]; ++i)
+        {
+            const float dot = D3DXVec3Dot(&m_worldVertices[neighbours[i]], &direction);
+            if(dot > furthestDot)
+            {
+                furthestDot = dot;
+                furthest = neighbours[i];
+            }
+        }
+    }
+    while(furthest != vertex);
+
+    return m_worldVertices[vertex];
+}
+
 void CollisionMesh::DrawDiagnostics()
 {
     if(m_draw && m_geometry &&
         m_engine->diagnostic()->AllowDiagnostics(Diagnostic::MESH))
     {
-        // Render world vertices
+        // Render world vertices; primitives keep none so are transformed here
         const std::string id = StringCast(this);
         const float vertexRadius = 0.1f;
-        const auto& vertices = GetVertices();
+        const auto& vertices = m_geometry->GetVertices();
         for(unsigned int i = 0; i < vertices.size(); ++i)
         {
+            D3DXVECTOR3 vertex;
+            D3DXVec3TransformCoord(&vertex, &vertices[i], &m_world.GetMatrix());
             m_engine->diagnostic()->UpdateSphere(Diagnostic::MESH,
                 "0" + StringCast(i) + id, Diagnostic::RED, 
-                vertices[i], vertexRadius);
+                vertex, vertexRadius);
         }
 
         // Render face normals
@@ -327,7 +470,7 @@ void CollisionMesh::UpdateCollision()
     {
         // Update the mesh vertices
         const auto& vertices = m_geometry->GetVertices();
-        for(unsigned int i = 0; i < vertices.size(); ++i)
+        for(unsigned int i = 0; i < m_worldVertices.size(); ++i)
         {
             if(m_requiresFullUpdate)
             {
@@ -6,7 +6,6 @@
 #include "common.h"
 #include "callbacks.h"
 #include "geometry.h"
-#include <deque>
 
 class Shader;
 class Partition;
@@ -54,6 +53,15 @@ public:
     void Initialise(bool createmesh, Geometry::Shape shape,
         const D3DXVECTOR3& scale, int divisions = 0);
 
+    /**
+    * Creates a collision model from loaded convex geometry
+    * @param geometry The geometry loaded with its vertices saved
+    * @param minScale Minimum allowed scale of the collision mesh
+    * @param maxScale Maximum allowed scale of the collision mesh
+    */
+    void Initialise(std::shared_ptr<Geometry> geometry,
+        const D3DXVECTOR3& minScale, const D3DXVECTOR3& maxScale);
+
     /**
     * Loads the collision as an instance of another
     * @param mesh The collision mesh to base the instance off
@@ -162,10 +170,25 @@ public:
 
     /**
     * @return the vertices of the mesh in world coordinates
-    * @note will update the vertices only once per tick if called
+    * @note empty for spheres, boxes and cylinders which use their transform instead
     */
     const std::vector<D3DXVECTOR3>& GetVertices() const;
 
+    /**
+    * Generates the furthest point of the collision geometry along a direction
+    * Known as a 'support' function; primitives answer from their transform
+    * while any other shape climbs its world vertices from the last one found
+    * @param direction The direction to search along
+    * @param vertex The vertex to start climbing from, set to the vertex found
+    * @return the furthest point in world coordinates
+    */
+    D3DXVECTOR3 GetSupportPoint(const D3DXVECTOR3& direction, int& vertex) const;
+
+    /**
+    * @return whether the shape is a sphere, box or cylinder
+    */
+    bool IsPrimitive() const;
+
     /**
     * @return the velocity for the collision mesh
     */
@@ -246,6 +269,18 @@ protected:
     */
     void DrawMesh(const Matrix& projection, const Matrix& view, const D3DXVECTOR3& color);
 
+    /**
+    * Generates the furthest world vertex along a direction by moving to
+    * the furthest neighbour until none are further; as the hull is convex 
+    * this is the furthest of all vertices and few steps are needed when 
+    * the direction changes little from the last search
+    * @param direction The direction to search along
+    * @param vertex The vertex to start climbing from, set to the vertex found
+    * @return The furthest world vertex along the given direction
+    * @note the position of the mesh is returned if no vertices are kept
+    */
+    const D3DXVECTOR3& FindFurthestVertex(const D3DXVECTOR3& direction, int& vertex) const;
+
     /**
     * Creates the local points of the OABB
     * @param width/height/depth The dimensions of the geometry
@@ -274,7 +309,7 @@ protected:
     D3DXVECTOR3 m_position;                    ///< Cached position of collision geometry
     std::vector<D3DXVECTOR3> m_localBounds;    ///< Local AABB points
     std::vector<D3DXVECTOR3> m_oabb;           ///< Bounds of the world coord OABB
-    std::vector<D3DXVECTOR3> m_worldVertices;  ///< Transformed vertices of the mesh
+    std::vector<D3DXVECTOR3> m_worldVertices;  ///< Transformed vertices of the mesh if not a primitive
     std::shared_ptr<Geometry> m_geometry;      ///< collision geometry mesh shared accross instances
     bool m_draw;                               ///< Whether to draw the geometry
     bool m_requiresFullUpdate;                 ///< Whether the collision mesh requires a full update
@@ -4,14 +4,29 @@
 
 #include "collisionsolver.h"
 #include "particle.h"
+#include "particlestore.h"
 #include "cloth.h"
 #include "simplex.h"
+#include "spatialhash.h"
 #include <assert.h>
 
+namespace
+{
+    const int MIN_CONTACTS = 64;                 ///< Initial number of slots in the contact table
+    const unsigned int HASH_PARTICLE = 73856093; ///< Large prime to spread particle addresses
+    const unsigned int HASH_HULL = 19349663;     ///< Large prime to spread hull addresses
+}
+
 CollisionSolver::CollisionSolver(std::shared_ptr<Engine> engine, 
                                  std::shared_ptr<Cloth> cloth) :
     m_cloth(cloth),
-    m_engine(engine)
+    m_engine(engine),
+    m_hash(new SpatialHash()),
+    m_analyticPrimitives(true),
+    m_tick(0),
+    m_hullTests(0),
+    m_hullIterations(0),
+    m_contactCount(0)
 {
 }
 
@@ -19,20 +34,22 @@ CollisionSolver::~CollisionSolver()
 {
 }
 
-void CollisionSolver::SolveParticleCollision(CollisionMesh& particleA, 
-                                             CollisionMesh& particleB)
+void CollisionSolver::SolveParticleCollision(ParticleStore& particles,
+                                             int indexA,
+                                             int indexB,
+                                             float radius)
 {
-    D3DXVECTOR3 particleToParticle = particleB.GetPosition() - particleA.GetPosition();
+    D3DXVECTOR3 particleToParticle = particles.GetPosition(indexB) - particles.GetPosition(indexA);
     const float lengthSqr = D3DXVec3LengthSq(&particleToParticle);
-    const float combinedRadius = particleA.GetRadius() + particleB.GetRadius();
+    const float combinedRadius = radius * 2.0f;
 
     if (lengthSqr < (combinedRadius*combinedRadius))
     {
         const float length = std::sqrt(lengthSqr);
         particleToParticle /= std::sqrt(length);
         const D3DXVECTOR3 translation = particleToParticle*fabs(combinedRadius-length);
-        particleA.ResolveCollision(-translation);
-        particleB.ResolveCollision(translation);
+        particles.MovePosition(indexA, -translation);
+        particles.MovePosition(indexB, translation);
     }
 }
 
@@ -47,45 +64,145 @@ void CollisionSolver::SolveParticleHullCollision(CollisionMesh& particle,
 
     if (lengthSqr < (combinedRadius*combinedRadius))
     {
-        Simplex simplex;
-        if(AreConvexHullsColliding(particle, hull, simplex))
+        // The pair warm starts from its contact last tick as resting contacts
+        // change little between ticks; meshes climb from their last support vertex
+        ContactCache& cache = FindContact(particle, hull);
+        cache.tick = m_tick;
+
+        D3DXVECTOR3 penetration;
+        if(FindHullPenetration(particle, hull, cache, penetration))
         {
-            simplex.GenerateFaces();
-            const D3DXVECTOR3 penetration = GetConvexHullPenetration(particle, hull, simplex);
             particle.ResolveCollision(penetration, hull.GetVelocity(), hull.GetShape());
         }
     }
 }
 
+ContactCache& CollisionSolver::FindContact(const CollisionMesh& particle, 
+                                           const CollisionMesh& hull)
+{
+    int slot = GetContactSlot(&particle, &hull);
+    if(!m_contacts.empty() && m_contacts[slot].particle)
+    {
+        return m_contacts[slot];
+    }
+
+    // Keep the table at most half full so probes stay short
+    if((m_contactCount + 1) * 2 > static_cast<int>(m_contacts.size()))
+    {
+        RebuildContacts(max(MIN_CONTACTS, static_cast<int>(m_contacts.size()) * 2), false);
+        slot = GetContactSlot(&particle, &hull);
+    }
+
+    ContactCache& cache = m_contacts[slot];
+    cache = ContactCache();
+    cache.particle = &particle;
+    cache.hull = &hull;
+    ++m_contactCount;
+    return cache;
+}
+
+int CollisionSolver::GetContactSlot(const CollisionMesh* particle,
+                                    const CollisionMesh* hull) const
+{
+    if(m_contacts.empty())
+    {
+        return NO_INDEX;
+    }
+
+    // Meshes are at least pointer aligned so the lowest bits carry nothing
+    const unsigned int mask = static_cast<unsigned int>(m_contacts.size() - 1);
+    const unsigned int hash = 
+        (static_cast<unsigned int>(reinterpret_cast<size_t>(particle) >> 2) * HASH_PARTICLE) ^
+        (static_cast<unsigned int>(reinterpret_cast<size_t>(hull) >> 2) * HASH_HULL);
+
+    unsigned int slot = hash & mask;
+    while(m_contacts[slot].particle && 
+        (m_contacts[slot].particle != particle || m_contacts[slot].hull != hull))
+    {
+        slot = (slot + 1) & mask;
+    }
+    return static_cast<int>(slot);
+}
+
+void CollisionSolver::RebuildContacts(int tableSize, bool retire)
+{
+    // Both tables keep their capacity so rebuilding at the same size never allocates
+    m_rebuilt.assign(tableSize, ContactCache());
+    m_rebuilt.swap(m_contacts);
+    m_contactCount = 0;
+
+    for(const ContactCache& contact : m_rebuilt)
+    {
+        if(contact.particle && (!retire || contact.tick == m_tick))
+        {
+            m_contacts[GetContactSlot(contact.particle, contact.hull)] = contact;
+            ++m_contactCount;
+        }
+    }
+}
+
+bool CollisionSolver::GetHullPenetration(const CollisionMesh& particle,
+                                         const CollisionMesh& hull,
+                                         D3DXVECTOR3& penetration)
+{
+    ContactCache cache;
+    return FindHullPenetration(particle, hull, cache, penetration);
+}
+
+bool CollisionSolver::FindHullPenetration(const CollisionMesh& particle,
+                                          const CollisionMesh& hull,
+                                          ContactCache& cache,
+                                          D3DXVECTOR3& penetration)
+{
+    Simplex simplex;
+    if(AreConvexHullsColliding(particle, hull, simplex, cache))
+    {
+        simplex.GenerateFaces();
+        penetration = GetConvexHullPenetration(particle, hull, simplex, cache);
+        return true;
+    }
+    return false;
+}
+
 bool CollisionSolver::AreConvexHullsColliding(const CollisionMesh& particle, 
                                               const CollisionMesh& hull, 
-                                              Simplex& simplex)
+                                              Simplex& simplex,
+                                              ContactCache& cache)
 {
     // If two convex hulls have collided, the Minkowski Sum A + (-B) of both 
     // hulls will contain the origin. Reference from 'Proximity Queries and 
     // Penetration Depth Computation on 3D Game Objects' by Gino van den Bergen
     // http://graphics.stanford.edu/courses/cs468-01-fall/Papers/van-den-bergen.pdf
 
-    const std::vector<D3DXVECTOR3>& particleVertices = particle.GetVertices();
-    const std::vector<D3DXVECTOR3>& hullVertices = hull.GetVertices();
-
-    // Determine an initial point for the simplex
-    const int initialIndex = 0;
-    D3DXVECTOR3 direction = particleVertices[initialIndex] - hullVertices[initialIndex];
-    D3DXVECTOR3 lastEdgePoint = GetMinkowskiSumEdgePoint(direction, particle, hull);
+    // Determine an initial point for the simplex along the axis that last 
+    // separated or penetrated the pair, which alone often decides the test
+    D3DXVECTOR3 direction = cache.axis;
+    if(IsZeroVector(direction))
+    {
+        direction = particle.GetPosition() - hull.GetPosition();
+    }
+    if(IsZeroVector(direction))
+    {
+        direction.y = 1.0f;
+    }
+    D3DXVECTOR3 lastEdgePoint = GetMinkowskiSumEdgePoint(direction, particle, hull, cache);
     simplex.AddPoint(lastEdgePoint);
-        
-    direction = -direction;
+
     int iteration = 0;
     bool collisionFound = false;
-    bool collisionPossible = true;
+    bool collisionPossible = D3DXVec3Dot(&lastEdgePoint, &direction) > 0;
     const int maxIterations = 20;
 
+    if(collisionPossible)
+    {
+        direction = -direction;
+    }
+
     // Iteratively create a simplex within the Minkowski Sum Hull
     while(iteration < maxIterations && !collisionFound && collisionPossible)
     {
         ++iteration;
-        lastEdgePoint = GetMinkowskiSumEdgePoint(direction, particle, hull);
+        lastEdgePoint = GetMinkowskiSumEdgePoint(direction, particle, hull, cache);
         simplex.AddPoint(lastEdgePoint);
 
         if(D3DXVec3Dot(&lastEdgePoint, &direction) <= 0)
@@ -106,19 +223,28 @@ bool CollisionSolver::AreConvexHullsColliding(const CollisionMesh& particle,
             collisionFound = SolveTetrahedronSimplex(simplex, direction);
         }
     }
+
+    if(!collisionPossible)
+    {
+        cache.axis = direction;
+    }
+
+    ++m_hullTests;
+    m_hullIterations += iteration + 1;
     return collisionFound;
 }
 
 D3DXVECTOR3 CollisionSolver::GetConvexHullPenetration(const CollisionMesh& particle, 
                                                       const CollisionMesh& hull, 
-                                                      Simplex& simplex)
+                                                      Simplex& simplex,
+                                                      ContactCache& cache)
 {
     D3DXVECTOR3 furthestPoint;
     D3DXVECTOR3 penetrationDirection;
     float penetrationDistance = 0.0f;
     bool penetrationFound = false;
     const float minDistance = 0.1f;
-    const int maxIterations = 10;
+    const int maxIterations = MAX_SIMPLEX_EXTENSIONS;
     int iteration = 0;
 
     while(!penetrationFound && iteration < maxIterations)
@@ -132,7 +258,7 @@ D3DXVECTOR3 CollisionSolver::GetConvexHullPenetration(const CollisionMesh& parti
         if(!penetrationFound)
         {
             // Check if there are any edge points beyond the closest face
-            furthestPoint = GetMinkowskiSumEdgePoint(face.normal, particle, hull);
+            furthestPoint = GetMinkowskiSumEdgePoint(face.normal, particle, hull, cache);
             const D3DXVECTOR3 faceToPoint = furthestPoint - simplex.GetPoint(face.indices[0]);
             const float distance = fabs(D3DXVec3Dot(&faceToPoint, &face.normal));
             penetrationFound = distance < minDistance;
@@ -158,32 +284,17 @@ D3DXVECTOR3 CollisionSolver::GetConvexHullPenetration(const CollisionMesh& parti
         UpdateDiagnostics(simplex, furthestPoint);
     }
 
+    cache.axis = penetrationDirection;
     return -(penetrationDirection * penetrationDistance);
 }
 
-const D3DXVECTOR3& CollisionSolver::FindFurthestPoint(const std::vector<D3DXVECTOR3>& points,
-                                                      const D3DXVECTOR3& direction) const
-{
-    int furthestIndex = 0;
-    float furthestDot = D3DXVec3Dot(&points[furthestIndex], &direction);
-    for(unsigned int i = 1; i < points.size(); ++i)
-    {
-        float dot = D3DXVec3Dot(&points[i], &direction);
-        if(dot > furthestDot)
-        {
-            furthestDot = dot;
-            furthestIndex = i;
-        }
-    }
-    return points[furthestIndex];
-}
-
 D3DXVECTOR3 CollisionSolver::GetMinkowskiSumEdgePoint(const D3DXVECTOR3& direction,
                                                          const CollisionMesh& particle, 
-                                                         const CollisionMesh& hull)
+                                                         const CollisionMesh& hull,
+                                                         ContactCache& cache)
 {
-    return FindFurthestPoint(particle.GetVertices(), direction) - 
-        FindFurthestPoint(hull.GetVertices(), -direction);
+    return particle.GetSupportPoint(direction, cache.particleVertex) - 
+        hull.GetSupportPoint(-direction, cache.hullVertex);
 }
 
 void CollisionSolver::SolveLineSimplex(const Simplex& simplex, D3DXVECTOR3& direction)
@@ -288,6 +399,149 @@ void CollisionSolver::SolveParticleSphereCollision(CollisionMesh& particle,
     }
 }
 
+void CollisionSolver::SolveParticleBoxCollision(CollisionMesh& particle,
+                                                const CollisionMesh& box)
+{
+    // The world matrix rows are the box axes scaled by the unit box size
+    const Matrix& world = box.CollisionMatrix();
+    D3DXVECTOR3 axes[] = { world.Right(), world.Up(), world.Forward() };
+    const D3DXVECTOR3 boxToParticle = particle.GetPosition() - box.GetPosition();
+    const float radius = particle.GetRadius();
+
+    D3DXVECTOR3 local, extents, closest;
+    for(int i = 0; i < 3; ++i)
+    {
+        const float length = D3DXVec3Length(&axes[i]);
+        axes[i] /= length;
+        extents[i] = length * 0.5f;
+        local[i] = D3DXVec3Dot(&boxToParticle, &axes[i]);
+        closest[i] = max(-extents[i], min(extents[i], local[i]));
+    }
+
+    D3DXVECTOR3 translation;
+    if(closest != local)
+    {
+        // Outside the box: push out along the line from the closest surface point
+        const D3DXVECTOR3 surfaceToParticle = local - closest;
+        const float lengthSqr = D3DXVec3LengthSq(&surfaceToParticle);
+        if(lengthSqr >= radius * radius)
+        {
+            return;
+        }
+
+        const float length = std::sqrt(lengthSqr);
+        const float distance = (radius - length) / length;
+        translation = ((axes[0] * surfaceToParticle.x) + (axes[1] * 
+            surfaceToParticle.y) + (axes[2] * surfaceToParticle.z)) * distance;
+    }
+    else
+    {
+        // Inside the box: push out through the nearest face
+        int face = 0;
+        for(int i = 1; i < 3; ++i)
+        {
+            if(extents[i] - fabs(local[i]) < extents[face] - fabs(local[face]))
+            {
+                face = i;
+            }
+        }
+        const float distance = extents[face] - fabs(local[face]) + radius;
+        translation = axes[face] * (local[face] < 0.0f ? -distance : distance);
+    }
+
+    particle.ResolveCollision(translation, box.GetVelocity(), box.GetShape());
+}
+
+void CollisionSolver::SolveParticleCylinderCollision(CollisionMesh& particle,
+                                                     const CollisionMesh& cylinder)
+{
+    // The unit cylinder has a radius of one along x/y and a length of one along z
+    const Matrix& world = cylinder.CollisionMatrix();
+    D3DXVECTOR3 axis = world.Forward();
+    const float halfLength = D3DXVec3Length(&axis) * 0.5f;
+    const float cylinderRadius = D3DXVec3Length(&world.Right());
+    axis /= halfLength * 2.0f;
+
+    const D3DXVECTOR3 cylinderToParticle = particle.GetPosition() - cylinder.GetPosition();
+    const float height = D3DXVec3Dot(&cylinderToParticle, &axis);
+    D3DXVECTOR3 radial = cylinderToParticle - (axis * height);
+    const float radialLength = D3DXVec3Length(&radial);
+    const float radius = particle.GetRadius();
+
+    D3DXVECTOR3 translation;
+    if(fabs(height) > halfLength || radialLength > cylinderRadius)
+    {
+        // Outside the cylinder: push out along the line from the closest surface point
+        const float closestHeight = max(-halfLength, min(halfLength, height));
+        const float closestRadial = min(radialLength, cylinderRadius);
+        D3DXVECTOR3 surfaceToParticle = axis * (height - closestHeight);
+        if(radialLength > 0.0f)
+        {
+            surfaceToParticle += radial * ((radialLength - closestRadial) / radialLength);
+        }
+
+        const float lengthSqr = D3DXVec3LengthSq(&surfaceToParticle);
+        if(lengthSqr >= radius * radius)
+        {
+            return;
+        }
+
+        const float length = std::sqrt(lengthSqr);
+        translation = surfaceToParticle * ((radius - length) / length);
+    }
+    else
+    {
+        // Inside the cylinder: push out through the nearest cap or the side
+        const float capDistance = halfLength - fabs(height);
+        const float sideDistance = cylinderRadius - radialLength;
+        if(capDistance < sideDistance || radialLength == 0.0f)
+        {
+            translation = axis * (height < 0.0f ? 
+                -(capDistance + radius) : capDistance + radius);
+        }
+        else
+        {
+            translation = radial * ((sideDistance + radius) / radialLength);
+        }
+    }
+
+    particle.ResolveCollision(translation, cylinder.GetVelocity(), cylinder.GetShape());
+}
+
+void CollisionSolver::SetAnalyticPrimitives(bool analytic)
+{
+    m_analyticPrimitives = analytic;
+}
+
+void CollisionSolver::ToggleAnalyticPrimitives()
+{
+    SetAnalyticPrimitives(!m_analyticPrimitives);
+}
+
+void CollisionSolver::RetireContacts()
+{
+    // Pairs not tested this tick have moved apart beyond the rough radius
+    // or belong to meshes that may no longer exist
+    if(m_contactCount > 0)
+    {
+        RebuildContacts(static_cast<int>(m_contacts.size()), true);
+    }
+
+    if(m_engine->diagnostic()->AllowDiagnostics(Diagnostic::TEXT))
+    {
+        m_engine->diagnostic()->UpdateText(Diagnostic::TEXT,
+            "Contacts", Diagnostic::WHITE, StringCast(m_contactCount));
+
+        m_engine->diagnostic()->UpdateText(Diagnostic::TEXT, 
+            "GJK Iterations", Diagnostic::WHITE, StringCast(m_hullTests == 0 ? 0.0f :
+            static_cast<float>(m_hullIterations) / static_cast<float>(m_hullTests)));
+    }
+
+    ++m_tick;
+    m_hullTests = 0;
+    m_hullIterations = 0;
+}
+
 void CollisionSolver::SolveClothCollision(const D3DXVECTOR3& minBounds, 
                                           const D3DXVECTOR3& maxBounds)
 {
@@ -295,19 +549,21 @@ void CollisionSolver::SolveClothCollision(const D3DXVECTOR3& minBounds,
 
     assert(!m_cloth.expired());
     auto cloth = m_cloth.lock();
-    auto& particles = cloth->GetParticles();
+    auto& particles = cloth->GetParticleStore();
+
+    // Solve the particles against themselves
+    SolveSelfCollision();
 
-    for(unsigned int i = 0; i < particles.size(); ++i)
+    for(int i = 0; i < particles.Size(); ++i)
     {
-        // Solve the particles against themselves
-        for(unsigned int j = i+1; j < particles.size(); ++j)
+        // Sleeping particles are held in place and already inside the walls
+        if(particles.HasFlag(i, ParticleStore::SLEEPING))
         {
-            SolveParticleCollision(particles[i]->GetCollisionMesh(), 
-                particles[j]->GetCollisionMesh());
+            continue;
         }
 
         // Solve the particle against the eight scene walls
-        const D3DXVECTOR3& particlePosition = particles[i]->GetPosition();
+        const D3DXVECTOR3& particlePosition = particles.GetPosition(i);
         D3DXVECTOR3 position(0.0, 0.0, 0.0);
 
         // Check for ground and roof collisions
@@ -340,21 +596,85 @@ void CollisionSolver::SolveClothCollision(const D3DXVECTOR3& minBounds,
             position.z = minBounds.z-particlePosition.z;
         }
 
-        particles[i]->MovePosition(position);
+        particles.MovePosition(i, position);
     }
 
+    // Scene objects are solved against the particle collision meshes
+    cloth->UpdateCollisionPositions();
+
     D3DPERF_EndEvent();
 }
 
+void CollisionSolver::SolveSelfCollision()
+{
+    assert(!m_cloth.expired());
+    auto cloth = m_cloth.lock();
+    auto& particles = cloth->GetParticleStore();
+    const int count = particles.Size();
+
+    // Particles can only touch if closer than their combined radius which is 
+    // the cloth spacing; any colliding pair will be in neighbouring grid cells
+    const float spacing = static_cast<float>(cloth->GetSpacing());
+    m_hash->Begin(count, spacing);
+    for(int i = 0; i < count; ++i)
+    {
+        m_hash->Insert(i, particles.GetPosition(i));
+    }
+    m_hash->End();
+
+    // Particle collision spheres are scaled to half the spacing
+    const float radius = spacing * 0.5f;
+    if(!cloth->HasSleepingRegions())
+    {
+        for(int i = 0; i < count; ++i)
+        {
+            m_hash->FindNeighbours(i, particles.GetPosition(i), m_neighbours);
+            for(int j : m_neighbours)
+            {
+                SolveParticleCollision(particles, i, j, radius);
+            }
+        }
+        return;
+    }
+
+    // Only awake particles search for neighbours; each awake pair is solved 
+    // once by the lower index and each pair with a sleeping particle by the awake one
+    for(int i = 0; i < count; ++i)
+    {
+        if(!particles.HasFlag(i, ParticleStore::SLEEPING))
+        {
+            m_hash->FindNeighbours(i, particles.GetPosition(i), m_neighbours, true);
+            for(int j : m_neighbours)
+            {
+                if(j > i || particles.HasFlag(j, ParticleStore::SLEEPING))
+                {
+                    SolveParticleCollision(particles, i, j, radius);
+                }
+            }
+        }
+    }
+}
+
 void CollisionSolver::SolveObjectCollision(CollisionMesh& particle,
                                            const CollisionMesh& object)
 {
     if(particle.IsDynamic())
     {
-        if(object.GetShape() == Geometry::SPHERE)
+        // Primitives are solved exactly from their transform; GJK and 
+        // EPA over the mesh vertices remain for any other convex shape
+        const Geometry::Shape shape = object.GetShape();
+        if(shape == Geometry::SPHERE)
         {
             SolveParticleSphereCollision(particle, object);
         }
+        else if(shape == Geometry::BOX && m_analyticPrimitives)
+        {
+            SolveParticleBoxCollision(particle, object);
+        }
+        else if(shape == Geometry::CYLINDER && m_analyticPrimitives)
+        {
+            SolveParticleCylinderCollision(particle, object);
+        }
         else
         {
             SolveParticleHullCollision(particle, object);
@@ -377,22 +697,21 @@ void CollisionSolver::UpdateDiagnostics(const Simplex& simplex,
         m_engine->diagnostic()->UpdateSphere(Diagnostic::COLLISION, 
             "FurthestPoint", Diagnostic::MAGENTA, furthestPoint, radius);
 
-        const auto& borders = simplex.GetBorderEdges();
-        for(unsigned int i = 0; i < borders.size(); ++i)
+        for(int i = 0; i < simplex.GetBorderEdgeCount(); ++i)
         {
+            const Edge& border = simplex.GetBorderEdge(i);
             m_engine->diagnostic()->UpdateLine(Diagnostic::COLLISION,
                 "BorderEdge" + StringCast(i), Diagnostic::RED, 
-                simplex.GetPoint(borders[i].indices[0]), 
-                simplex.GetPoint(borders[i].indices[1]));                    
+                simplex.GetPoint(border.indices[0]), 
+                simplex.GetPoint(border.indices[1]));                    
         }
 
-        const auto& faces = simplex.GetFaces();
-        for(unsigned int i = 0; i < faces.size(); ++i)
+        for(int i = 0; i < simplex.GetFaceCount(); ++i)
         {
-            if(faces[i].alive)
+            const Face& face = simplex.GetFace(i);
+            if(face.alive)
             {
                 std::string id = StringCast(i);
-                const Face& face = faces[i];
 
                 const D3DXVECTOR3 center = simplex.GetFaceCenter(i);
                 const D3DXVECTOR3& normal = face.normal * normalLength;
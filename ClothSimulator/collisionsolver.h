@@ -9,7 +9,28 @@
 struct Face;
 class Simplex;
 class Particle;
+class ParticleStore;
 class Cloth;
+class SpatialHash;
+
+/**
+* Contact state kept between ticks for a particle and a hull
+*/
+struct ContactCache
+{
+    /**
+    * Constructor
+    */
+    ContactCache() : particle(nullptr), hull(nullptr), axis(0.0f, 0.0f, 0.0f), 
+        tick(0), particleVertex(0), hullVertex(0) {}
+
+    const CollisionMesh* particle;  ///< Particle of the pair or null if the slot is empty
+    const CollisionMesh* hull;      ///< Hull of the pair
+    D3DXVECTOR3 axis;               ///< Last separating axis or penetration normal of the pair
+    int tick;                       ///< Last tick the pair was tested
+    int particleVertex;             ///< Last support vertex of the particle
+    int hullVertex;                 ///< Last support vertex of the hull
+};
 
 /**
 * Detects and solves cloth-object and cloth-cloth collisions
@@ -37,6 +58,12 @@ public:
     */
     void SolveClothCollision(const D3DXVECTOR3& minBounds, const D3DXVECTOR3& maxBounds);
 
+    /**
+    * Detects and solves cloth particle-particle collisions
+    * @note uses a spatial hash broadphase sized from the cloth spacing
+    */
+    void SolveSelfCollision();
+
     /**
     * Detects and solves cloth and scene object-particle collisions
     * @param particle The collision mesh for the particle
@@ -44,6 +71,40 @@ public:
     */
     void SolveObjectCollision(CollisionMesh& particle, const CollisionMesh& object);
 
+    /**
+    * @param analytic Whether boxes and cylinders are solved exactly from their
+    *        transform rather than with GJK and EPA over their mesh vertices
+    */
+    void SetAnalyticPrimitives(bool analytic);
+
+    /**
+    * @return whether boxes and cylinders are solved exactly from their transform
+    */
+    bool IsUsingAnalyticPrimitives() const { return m_analyticPrimitives; }
+
+    /**
+    * Toggles whether boxes and cylinders are solved exactly from their transform
+    */
+    void ToggleAnalyticPrimitives();
+
+    /**
+    * Removes any cached contacts not tested since the last call
+    * @note call once per tick after all collisions are solved
+    * @note the contact table keeps its memory, only growing past its largest size
+    */
+    void RetireContacts();
+
+    /**
+    * Finds the penetration between a particle and convex hull with GJK and EPA
+    * @param particle The collision mesh for the particle
+    * @param hull The collision mesh for the convex hull
+    * @param penetration Set to the direction and magnitude to move the particle by
+    * @return whether the particle and hull are colliding
+    * @note starts without any cached contact for the pair
+    */
+    bool GetHullPenetration(const CollisionMesh& particle, 
+        const CollisionMesh& hull, D3DXVECTOR3& penetration);
+
 private:
 
     /**
@@ -54,10 +115,12 @@ private:
 
     /**
     * Detects and solves a collision between two particles
-    * @param particleA The collision mesh for the first particle
-    * @param particleB The collision mesh for the second particle
+    * @param particles The simulated state of all particles
+    * @param indexA/indexB The indices of the two particles
+    * @param radius The collision radius of a particle
     */
-    void SolveParticleCollision(CollisionMesh& particleA, CollisionMesh& particleB);
+    void SolveParticleCollision(ParticleStore& particles, 
+        int indexA, int indexB, float radius);
 
     /**
     * Detects and solves a collision between a convex hull and a particle
@@ -66,6 +129,39 @@ private:
     */
     void SolveParticleHullCollision(CollisionMesh& particle, const CollisionMesh& hull);
 
+    /**
+    * Finds the penetration between a particle and convex hull with GJK and EPA
+    * @param particle The collision mesh for the particle
+    * @param hull The collision mesh for the convex hull
+    * @param cache The contact to warm start from and update
+    * @param penetration Set to the direction and magnitude to move the particle by
+    * @return whether the particle and hull are colliding
+    */
+    bool FindHullPenetration(const CollisionMesh& particle, const CollisionMesh& hull,
+        ContactCache& cache, D3DXVECTOR3& penetration);
+
+    /**
+    * Finds the contact for a particle and hull, adding it if not cached
+    * @param particle The collision mesh for the particle
+    * @param hull The collision mesh for the convex hull
+    * @return the contact for the pair
+    */
+    ContactCache& FindContact(const CollisionMesh& particle, const CollisionMesh& hull);
+
+    /**
+    * @param particle The collision mesh for the particle
+    * @param hull The collision mesh for the convex hull
+    * @return the slot holding the pair or the empty slot it would be added to
+    */
+    int GetContactSlot(const CollisionMesh* particle, const CollisionMesh* hull) const;
+
+    /**
+    * Moves cached contacts into a cleared table of the given size
+    * @param tableSize The power of two number of slots for the table
+    * @param retire Whether to drop contacts not tested this tick
+    */
+    void RebuildContacts(int tableSize, bool retire);
+
     /**
     * Detects and solves a collision between a sphere and particle
     * @param particle The collision mesh for the particle
@@ -74,25 +170,31 @@ private:
     void SolveParticleSphereCollision(CollisionMesh& particle, const CollisionMesh& sphere);
 
     /**
-    * Generates the furthest point along a direction from a set of points
-    * @param direction The direction to search along
-    * @param points The set of points to search
-    * @return The furthest point in the set along the given direction
+    * Detects and solves a collision between an oriented box and particle
+    * @param particle The collision mesh for the particle
+    * @param box The collision mesh for the box
+    */
+    void SolveParticleBoxCollision(CollisionMesh& particle, const CollisionMesh& box);
+
+    /**
+    * Detects and solves a collision between a capped cylinder and particle
+    * @param particle The collision mesh for the particle
+    * @param cylinder The collision mesh for the cylinder
     */
-    const D3DXVECTOR3& FindFurthestPoint(const std::vector<D3DXVECTOR3>& points,
-        const D3DXVECTOR3& direction) const;
+    void SolveParticleCylinderCollision(CollisionMesh& particle, const CollisionMesh& cylinder);
 
     /**
     * Generates a point on the edge of the Minkowski Sum hull
-    * using a chosen vertex from each collision mesh that is furthest
+    * using the point of each collision mesh that is furthest
     * along the given direction. Known as a 'support' function.
     * @param direction The direction to search along
     * @param particle The collision mesh for the particle
     * @param hull The collision mesh for the convex hull
+    * @param cache The contact holding the vertices to start each support search from
     * @return an edge point in the Minkowski Sum
     */
     D3DXVECTOR3 GetMinkowskiSumEdgePoint(const D3DXVECTOR3& direction,
-        const CollisionMesh& particle, const CollisionMesh& hull);
+        const CollisionMesh& particle, const CollisionMesh& hull, ContactCache& cache);
 
     /**
     * Determines the next search direction given a line simplex
@@ -121,20 +223,22 @@ private:
     * @param particle The collision mesh for the particle
     * @param hull The collision mesh for the convex hull
     * @param simplex An empty simplex to fill with at most four points
+    * @param cache The contact to warm start from and update
     * @return whether the two convex hulls are colliding
     */
     bool AreConvexHullsColliding(const CollisionMesh& particle, 
-        const CollisionMesh& hull, Simplex& simplex);
+        const CollisionMesh& hull, Simplex& simplex, ContactCache& cache);
 
     /**
     * Uses the theory of EPA to determine penetration between two convex hulls
     * @param particle The collision mesh for the particle
     * @param hull The collision mesh for the convex hull
     * @param simplex The tetrahedron simplex encasing the origin
+    * @param cache The contact to record the penetration normal in
     * @return The direction and magnitude of penetration between the hulls
     */
     D3DXVECTOR3 GetConvexHullPenetration(const CollisionMesh& particle, 
-        const CollisionMesh& hull, Simplex& simplex);
+        const CollisionMesh& hull, Simplex& simplex, ContactCache& cache);
 
     /**
     * Updates the diagnostics for a simplex
@@ -143,6 +247,15 @@ private:
     */
     void UpdateDiagnostics(const Simplex& simplex, const D3DXVECTOR3& furthestPoint);
 
-    std::weak_ptr<Cloth> m_cloth;     ///< Cloth object holding all particles
-    std::shared_ptr<Engine> m_engine; ///< Callbacks for the rendering engine
+    std::weak_ptr<Cloth> m_cloth;          ///< Cloth object holding all particles
+    std::shared_ptr<Engine> m_engine;      ///< Callbacks for the rendering engine
+    std::unique_ptr<SpatialHash> m_hash;   ///< Broadphase for particle self collisions
+    std::vector<int> m_neighbours;         ///< Cached particles found near a particle
+    bool m_analyticPrimitives;             ///< Whether boxes and cylinders are solved exactly
+    int m_tick;                            ///< Number of times contacts have been retired
+    int m_hullTests;                       ///< Number of GJK tests this tick
+    int m_hullIterations;                  ///< Number of GJK support points found this tick
+    int m_contactCount;                    ///< Number of filled slots in the contact table
+    std::vector<ContactCache> m_contacts;  ///< Open addressed table of recently tested pairs
+    std::vector<ContactCache> m_rebuilt;   ///< Spare table live contacts are moved into
 };
\ No newline at end of file
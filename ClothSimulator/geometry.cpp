@@ -5,6 +5,14 @@
 #include "geometry.h"
 #include "assimpmesh.h"
 #include "diagnostic.h"
+#include <algorithm>
+#include <tuple>
+#include <map>
+
+namespace
+{
+    const float WELD_DISTANCE = 1.0e-4f; ///< Furthest apart duplicate vertices are joined
+}
 
 D3DXVertex::D3DXVertex() :
     normal(0.0f, 0.0f, 0.0f),
@@ -43,7 +51,8 @@ MeshVertex::MeshVertex() :
 
 Geometry::Geometry(LPDIRECT3DDEVICE9 d3ddev, 
                    const std::string& filename,
-                   LPD3DXEFFECT shader) :
+                   LPD3DXEFFECT shader,
+                   bool saveVertices) :
     m_shape(NONE),
     m_mesh(nullptr),
     m_shader(shader),
@@ -120,7 +129,7 @@ Geometry::Geometry(LPDIRECT3DDEVICE9 d3ddev,
     std::copy(indexData.begin(), indexData.end(), indexBuffer);
     m_mesh->UnlockIndexBuffer();
 
-    CreateMeshData<MeshVertex, DWORD>(false);
+    CreateMeshData<MeshVertex, DWORD>(saveVertices);
 }
 
 Geometry::Geometry(LPDIRECT3DDEVICE9 device, 
@@ -194,6 +203,7 @@ template<typename Vertex, typename Index> void Geometry::CreateMeshData(bool sav
     m_mesh->UnlockVertexBuffer();
 
     // Create cached polygons
+    std::vector<DWORD> indices(indexNumber);
     void* ibuffer = nullptr;
     m_mesh->LockIndexBuffer(0, &ibuffer);
     Index* indexBuffer = static_cast<Index*>(ibuffer);
@@ -203,15 +213,30 @@ template<typename Vertex, typename Index> void Geometry::CreateMeshData(bool sav
         const D3DXVECTOR3& v1 = m_vertices[indexBuffer[i+1]];
         const D3DXVECTOR3& v2 = m_vertices[indexBuffer[i+2]];
         m_faces.emplace_back(v0, v1, v2);
+
+        indices[i] = indexBuffer[i];
+        indices[i+1] = indexBuffer[i+1];
+        indices[i+2] = indexBuffer[i+2];
     }
     m_mesh->UnlockIndexBuffer();
 
+    m_neighbourStart.clear();
+    m_neighbours.clear();
+
     if(saveVertices)
     {
         // Remove any duplicates as directx creates 
         // 3 vertices for every triangle
+        const std::vector<D3DXVECTOR3> vertices(m_vertices);
         m_vertices.erase(std::unique(m_vertices.begin(), 
             m_vertices.end()), m_vertices.end()); 
+
+        // Primitives answer support queries from their transform
+        // so only loaded hulls search across their vertices
+        if(m_shape == NONE)
+        {
+            CreateAdjacency(vertices, indices);
+        }
     }
     else
     {
@@ -219,6 +244,86 @@ template<typename Vertex, typename Index> void Geometry::CreateMeshData(bool sav
     }
 }
 
+void Geometry::CreateAdjacency(const std::vector<D3DXVECTOR3>& vertices, 
+                               const std::vector<DWORD>& indices)
+{
+    // Saved vertices only drop duplicates that follow each other
+    std::vector<int> saved(vertices.size());
+    for(unsigned int i = 0, index = 0; i < vertices.size(); ++i)
+    {
+        index += i > 0 && vertices[i] != vertices[i-1] ? 1 : 0;
+        saved[i] = index;
+    }
+
+    // Duplicates left at the seams may differ by rounding; vertices within the
+    // weld distance are joined through the first of them so the surface has 
+    // no seams for a search across it to become stuck on
+    typedef std::tuple<int, int, int> Cell;
+    std::map<Cell, std::vector<int>> cells;
+    std::vector<int> welded(m_vertices.size());
+    for(unsigned int i = 0; i < m_vertices.size(); ++i)
+    {
+        const D3DXVECTOR3& vertex = m_vertices[i];
+        const int x = static_cast<int>(std::floor(vertex.x / WELD_DISTANCE));
+        const int y = static_cast<int>(std::floor(vertex.y / WELD_DISTANCE));
+        const int z = static_cast<int>(std::floor(vertex.z / WELD_DISTANCE));
+
+        welded[i] = i;
+        for(int j = 0; j < 27 && welded[i] == static_cast<int>(i); ++j)
+        {
+            auto cell = cells.find(Cell(x + (j % 3) - 1, y + ((j / 3) % 3) - 1, z + (j / 9) - 1));
+            if(cell != cells.end())
+            {
+                for(int other : cell->second)
+                {
+                    const D3DXVECTOR3 difference = vertex - m_vertices[other];
+                    if(D3DXVec3LengthSq(&difference) < WELD_DISTANCE * WELD_DISTANCE)
+                    {
+                        welded[i] = welded[other];
+                        break;
+                    }
+                }
+            }
+        }
+        cells[Cell(x, y, z)].push_back(i);
+    }
+
+    std::vector<std::pair<int, int>> edges;
+    edges.reserve(indices.size() * 2);
+    for(unsigned int i = 0; i < indices.size(); i += POINTS_IN_FACE)
+    {
+        int corners[POINTS_IN_FACE];
+        for(int j = 0; j < POINTS_IN_FACE; ++j)
+        {
+            corners[j] = welded[saved[indices[i+j]]];
+        }
+        for(int j = 0; j < POINTS_IN_FACE; ++j)
+        {
+            const int corner = corners[j];
+            const int next = corners[(j+1) % POINTS_IN_FACE];
+            if(corner != next)
+            {
+                edges.push_back(std::make_pair(corner, next));
+                edges.push_back(std::make_pair(next, corner));
+            }
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    m_neighbourStart.assign(m_vertices.size() + 1, 0);
+    m_neighbours.resize(edges.size());
+    for(unsigned int i = 0; i < edges.size(); ++i)
+    {
+        ++m_neighbourStart[edges[i].first + 1];
+        m_neighbours[i] = edges[i].second;
+    }
+    for(unsigned int i = 1; i < m_neighbourStart.size(); ++i)
+    {
+        m_neighbourStart[i] += m_neighbourStart[i-1];
+    }
+}
+
 Geometry::Shape Geometry::GetShape() const
 { 
     return m_shape;
@@ -249,6 +354,16 @@ const std::vector<MeshFace>& Geometry::GetFaces() const
     return m_faces;
 }
 
+const std::vector<int>& Geometry::GetNeighbourStart() const 
+{ 
+    return m_neighbourStart;
+}
+
+const std::vector<int>& Geometry::GetNeighbours() const 
+{ 
+    return m_neighbours;
+}
+
 void Geometry::UpdateDiagnostics(Diagnostic& renderer, const D3DXMATRIX& world)
 {
     if(renderer.AllowDiagnostics(Diagnostic::MESH))
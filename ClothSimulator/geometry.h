@@ -94,10 +94,12 @@ public:
     * @param device The directx device
     * @param filename The filename of the mesh
     * @param shader The shader of the mesh
+    * @param saveVertices Whether to keep the vertices for use as a convex hull
     */
     Geometry(LPDIRECT3DDEVICE9 device, 
         const std::string& filename, 
-        LPD3DXEFFECT shader);
+        LPD3DXEFFECT shader,
+        bool saveVertices = false);
 
     /**
     * Destructor
@@ -134,6 +136,17 @@ public:
     */
     const std::vector<MeshFace>& GetFaces() const;
 
+    /**
+    * @return the start of each vertex's neighbours with one past the last vertex at the end
+    * @note empty for primitives and if the vertices are not saved
+    */
+    const std::vector<int>& GetNeighbourStart() const;
+
+    /**
+    * @return the vertices sharing an edge with each vertex
+    */
+    const std::vector<int>& GetNeighbours() const;
+
     /**
     * Loads a texture for the mesh
     * @param d3ddev the directX device
@@ -161,10 +174,20 @@ private:
     template<typename Vertex, typename Index> 
     void CreateMeshData(bool saveVertices);
 
+    /**
+    * Connects each saved vertex to the vertices it shares an edge with
+    * @param vertices All vertices of the mesh including any duplicates
+    * @param indices Three indices into all vertices for each face
+    */
+    void CreateAdjacency(const std::vector<D3DXVECTOR3>& vertices, 
+        const std::vector<DWORD>& indices);
+
     Shape m_shape;                       ///< Type of shape of the collision geometry
     LPD3DXMESH m_mesh;                   ///< Directx geometry mesh
     LPDIRECT3DTEXTURE9 m_texture;        ///< The texture attached to the mesh
     LPD3DXEFFECT m_shader;               ///< The shader attached to the mesh
     std::vector<D3DXVECTOR3> m_vertices; ///< vertices of the mesh
     std::vector<MeshFace> m_faces;       ///< Cached local faces of the mesh
+    std::vector<int> m_neighbourStart;   ///< Start of each vertex's neighbours
+    std::vector<int> m_neighbours;       ///< Vertices sharing an edge with each vertex
 };
\ No newline at end of file
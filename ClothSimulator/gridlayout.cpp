@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - gridlayout.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "gridlayout.h"
+#include <algorithm>
+
+namespace
+{
+    const int TILE_ROWS = 8;  ///< Rows and columns of particles in each tile
+
+    /**
+    * Spreads the lower 16 bits of the value out to every second bit
+    * @param value The value to spread
+    * @return the spread value
+    */
+    unsigned int SpreadBits(unsigned int value)
+    {
+        value &= 0x0000FFFF;
+        value = (value | (value << 8)) & 0x00FF00FF;
+        value = (value | (value << 4)) & 0x0F0F0F0F;
+        value = (value | (value << 2)) & 0x33333333;
+        value = (value | (value << 1)) & 0x55555555;
+        return value;
+    }
+}
+
+GridLayout::GridLayout() :
+    m_rows(0),
+    m_order(ROW_MAJOR)
+{
+}
+
+void GridLayout::Initialise(int rows, Order order)
+{
+    m_rows = rows;
+    m_order = order;
+    m_particles.clear();
+    m_cells.clear();
+
+    if(rows <= 0 || order == ROW_MAJOR)
+    {
+        return;
+    }
+
+    // Each cell is given a key along the curve; partial tiles or curve
+    // sections at the grid edges are skipped by ranking the keys
+    const int tiles = (rows + TILE_ROWS - 1) / TILE_ROWS;
+    std::vector<std::pair<unsigned int, int>> keys(rows * rows);
+    for(int column = 0; column < rows; ++column)
+    {
+        for(int row = 0; row < rows; ++row)
+        {
+            unsigned int key = 0;
+            if(order == TILED)
+            {
+                const int tile = ((column / TILE_ROWS) * tiles) + (row / TILE_ROWS);
+                const int local = ((column % TILE_ROWS) * TILE_ROWS) + (row % TILE_ROWS);
+                key = (tile * TILE_ROWS * TILE_ROWS) + local;
+            }
+            else
+            {
+                key = (SpreadBits(column) << 1) | SpreadBits(row);
+            }
+
+            const int cell = (column * rows) + row;
+            keys[cell] = std::make_pair(key, cell);
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+
+    m_particles.resize(keys.size());
+    m_cells.resize(keys.size());
+    for(unsigned int i = 0; i < keys.size(); ++i)
+    {
+        m_cells[i] = keys[i].second;
+        m_particles[keys[i].second] = i;
+    }
+}
+
+std::string GridLayout::GetOrderName(Order order)
+{
+    switch(order)
+    {
+    case ROW_MAJOR:
+        return "Row Major";
+    case TILED:
+        return "Tiled";
+    case Z_ORDER:
+        return "Z-Order";
+    default:
+        return "None";
+    }
+}
@@ -0,0 +1,87 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - gridlayout.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+
+/**
+* Maps the columns and rows of the particle grid to particle indices
+* Particles can be stored a column at a time or grouped so particles
+* near each other in both directions are also near in memory
+*/
+class GridLayout
+{
+public:
+
+    /**
+    * Orders the particles can be stored in
+    */
+    enum Order
+    {
+        ROW_MAJOR,  ///< Each column of particles is stored one after the other
+        TILED,      ///< Square tiles of particles are stored one after the other
+        Z_ORDER,    ///< Particles are stored along a Morton curve
+        MAX_ORDERS
+    };
+
+    /**
+    * Constructor
+    */
+    GridLayout();
+
+    /**
+    * Builds the mapping for a grid
+    * @param rows The number of rows and columns of the grid or zero for no grid
+    * @param order The order to store the particles in
+    */
+    void Initialise(int rows, Order order);
+
+    /**
+    * @param column/row The column and row of the grid
+    * @return the index of the particle at the column and row
+    */
+    int GetParticle(int column, int row) const
+    {
+        const int cell = (column * m_rows) + row;
+        return m_particles.empty() ? cell : m_particles[cell];
+    }
+
+    /**
+    * @param index The index of the particle
+    * @return the column * rows + row of the particle in the grid
+    */
+    int GetCell(int index) const
+    {
+        return m_cells.empty() ? index : m_cells[index];
+    }
+
+    /**
+    * @return the number of rows and columns of the grid or zero for no grid
+    */
+    int GetRows() const { return m_rows; }
+
+    /**
+    * @return the order the particles are stored in
+    */
+    Order GetOrder() const { return m_order; }
+
+    /**
+    * @param order The order to get the name for
+    * @return the name of the order
+    */
+    static std::string GetOrderName(Order order);
+
+private:
+
+    /**
+    * Prevent copying
+    */
+    GridLayout(const GridLayout&) = delete;
+    GridLayout& operator=(const GridLayout&) = delete;
+
+    int m_rows;                     ///< Number of rows and columns of the grid
+    Order m_order;                  ///< Order the particles are stored in
+    std::vector<int> m_particles;   ///< Particle for each cell; empty when row major
+    std::vector<int> m_cells;       ///< Cell for each particle; empty when row major
+};
@@ -0,0 +1,328 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - implicitsolver.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "implicitsolver.h"
+#include "particlestore.h"
+#include "threadpool.h"
+#include <algorithm>
+
+namespace
+{
+    const int BLOCK_SIZE = 9;            ///< Values in each 3x3 block of the system matrix
+    const int MAX_ITERATIONS = 100;      ///< Most conjugate gradient iterations for a step
+    const float TOLERANCE = 0.0001f;     ///< Residual relative to the right hand side to stop at
+    const int MIN_PARALLEL_ROWS = 512;   ///< Smallest amount of rows worth splitting across threads
+
+    /**
+    * @return the dot product of two vector arrays
+    */
+    float Dot(const ImplicitSolver::VectorArray& a, const ImplicitSolver::VectorArray& b)
+    {
+        float dot = 0.0f;
+        const int count = static_cast<int>(a.size());
+        for(int i = 0; i < count; ++i)
+        {
+            dot += D3DXVec3Dot(&a[i], &b[i]);
+        }
+        return dot;
+    }
+
+    /**
+    * Multiplies a row-major 3x3 block by a vector
+    */
+    D3DXVECTOR3 MultiplyBlock(const float* block, const D3DXVECTOR3& vector)
+    {
+        return D3DXVECTOR3(
+            block[0]*vector.x + block[1]*vector.y + block[2]*vector.z,
+            block[3]*vector.x + block[4]*vector.y + block[5]*vector.z,
+            block[6]*vector.x + block[7]*vector.y + block[8]*vector.z);
+    }
+}
+
+ImplicitSolver::ImplicitSolver(ThreadPool& threads) :
+    m_threads(threads),
+    m_iterations(0)
+{
+}
+
+void ImplicitSolver::Initialise(const PackedSprings& springs, int particleCount)
+{
+    const int springCount = static_cast<int>(springs.rest.size());
+
+    // Each particle couples with itself and every particle it shares a spring with
+    std::vector<std::vector<int>> neighbours(particleCount);
+    for(int i = 0; i < particleCount; ++i)
+    {
+        neighbours[i].push_back(i);
+    }
+    for(int i = 0; i < springCount; ++i)
+    {
+        neighbours[springs.index1[i]].push_back(springs.index2[i]);
+        neighbours[springs.index2[i]].push_back(springs.index1[i]);
+    }
+
+    m_rowStart.assign(particleCount + 1, 0);
+    m_columns.clear();
+    m_diagonal.resize(particleCount);
+    for(int i = 0; i < particleCount; ++i)
+    {
+        std::vector<int>& row = neighbours[i];
+        std::sort(row.begin(), row.end());
+        row.erase(std::unique(row.begin(), row.end()), row.end());
+
+        m_rowStart[i] = static_cast<int>(m_columns.size());
+        for(int column : row)
+        {
+            if(column == i)
+            {
+                m_diagonal[i] = static_cast<int>(m_columns.size());
+            }
+            m_columns.push_back(column);
+        }
+    }
+    m_rowStart[particleCount] = static_cast<int>(m_columns.size());
+
+    auto findBlock = [this](int row, int column) -> int
+    {
+        const auto begin = m_columns.begin() + m_rowStart[row];
+        const auto end = m_columns.begin() + m_rowStart[row+1];
+        return static_cast<int>(std::lower_bound(begin, end, column) - m_columns.begin());
+    };
+
+    m_springBlocks.resize(springCount * 2);
+    for(int i = 0; i < springCount; ++i)
+    {
+        m_springBlocks[i*2] = findBlock(springs.index1[i], springs.index2[i]);
+        m_springBlocks[i*2+1] = findBlock(springs.index2[i], springs.index1[i]);
+    }
+
+    m_blocks.resize(m_columns.size() * BLOCK_SIZE);
+    m_fixed.resize(particleCount);
+    m_velocity.resize(particleCount);
+    m_rhs.resize(particleCount);
+    m_deltaVelocity.resize(particleCount);
+    m_residual.resize(particleCount);
+    m_direction.resize(particleCount);
+    m_product.resize(particleCount);
+    m_preconditioned.resize(particleCount);
+    m_inverseDiagonal.resize(particleCount);
+}
+
+void ImplicitSolver::Step(const PackedSprings& springs,
+                          ParticleStore& particles,
+                          const float* stiffnesses,
+                          bool bend,
+                          float timestep,
+                          float damping)
+{
+    Assemble(springs, particles, stiffnesses, bend, timestep);
+    m_iterations = SolveConjugateGradient();
+
+    const int particleCount = particles.Size();
+    for(int i = 0; i < particleCount; ++i)
+    {
+        const D3DXVECTOR3 position = particles.GetPosition(i);
+        particles.SetPreviousPosition(i, position);
+
+        if(m_fixed[i] == 0.0f)
+        {
+            const D3DXVECTOR3 velocity = (m_velocity[i] + m_deltaVelocity[i]) * damping;
+            particles.SetPosition(i, position + velocity * timestep);
+        }
+    }
+}
+
+void ImplicitSolver::Assemble(const PackedSprings& springs,
+                              const ParticleStore& particles,
+                              const float* stiffnesses,
+                              bool bend,
+                              float timestep)
+{
+    // Solves (M - h^2 df/dx) dv = h (f + h df/dx v) for the change in velocity dv
+    const int particleCount = particles.Size();
+    const float timestepSqr = timestep * timestep;
+
+    std::fill(m_blocks.begin(), m_blocks.end(), 0.0f);
+    for(int i = 0; i < particleCount; ++i)
+    {
+        const float inverseMass = particles.GetInverseMass(i);
+        const bool fixed = inverseMass == 0.0f ||
+            particles.HasFlag(i, ParticleStore::COLLIDING);
+
+        m_fixed[i] = fixed ? 1.0f : 0.0f;
+        m_velocity[i] = fixed ? D3DXVECTOR3(0.0f, 0.0f, 0.0f) :
+            (particles.GetPosition(i) - particles.GetPreviousPosition(i)) / timestep;
+
+        // Held particles keep an identity row so their change in velocity solves to zero
+        const float mass = fixed ? 1.0f : 1.0f / inverseMass;
+        float* diagonal = &m_blocks[m_diagonal[i] * BLOCK_SIZE];
+        diagonal[0] = diagonal[4] = diagonal[8] = mass;
+
+        m_rhs[i] = fixed ? D3DXVECTOR3(0.0f, 0.0f, 0.0f) :
+            particles.GetAcceleration(i) * (mass * timestep);
+    }
+
+    // Springs are grouped into runs of one type so the stiffness is found once for each run
+    const int runCount = static_cast<int>(springs.typeStart.size()) - 1;
+    for(int run = 0; run < runCount; ++run)
+    {
+        const int type = run % Spring::MAX_TYPES;
+        if(!bend && type == Spring::BEND)
+        {
+            continue;
+        }
+
+        const float stiffness = stiffnesses[type];
+        for(int i = springs.typeStart[run]; i < springs.typeStart[run+1]; ++i)
+        {
+            const int index1 = springs.index1[i];
+            const int index2 = springs.index2[i];
+            const D3DXVECTOR3 difference = particles.GetPosition(index2) - particles.GetPosition(index1);
+            const float length = D3DXVec3Length(&difference);
+            if(length == 0.0f)
+            {
+                continue;
+            }
+
+            const D3DXVECTOR3 direction = difference / length;
+            const D3DXVECTOR3 force = direction * (stiffness * (length - springs.rest[i]));
+
+            // Jacobian of the force on the first particle by the second particle's position
+            // The transverse term is clamped when compressed to keep the system definite
+            const float transverse = max(0.0f, 1.0f - springs.rest[i] / length);
+            const float axial = 1.0f - transverse;
+            const float d[3] = { direction.x, direction.y, direction.z };
+            float jacobian[BLOCK_SIZE];
+            for(int r = 0; r < 3; ++r)
+            {
+                for(int c = 0; c < 3; ++c)
+                {
+                    jacobian[r*3+c] = stiffness * ((axial * d[r] * d[c]) + (r == c ? transverse : 0.0f));
+                }
+            }
+
+            const bool fixed1 = m_fixed[index1] != 0.0f;
+            const bool fixed2 = m_fixed[index2] != 0.0f;
+            const D3DXVECTOR3 relativeVelocity = m_velocity[index2] - m_velocity[index1];
+            const D3DXVECTOR3 impulse = (force + MultiplyBlock(jacobian, relativeVelocity) * timestep) * timestep;
+
+            if(!fixed1)
+            {
+                AddBlock(m_diagonal[index1], jacobian, timestepSqr);
+                m_rhs[index1] += impulse;
+            }
+            if(!fixed2)
+            {
+                AddBlock(m_diagonal[index2], jacobian, timestepSqr);
+                m_rhs[index2] -= impulse;
+            }
+            if(!fixed1 && !fixed2)
+            {
+                AddBlock(m_springBlocks[i*2], jacobian, -timestepSqr);
+                AddBlock(m_springBlocks[i*2+1], jacobian, -timestepSqr);
+            }
+        }
+    }
+
+    for(int i = 0; i < particleCount; ++i)
+    {
+        const float* diagonal = &m_blocks[m_diagonal[i] * BLOCK_SIZE];
+        m_inverseDiagonal[i] = D3DXVECTOR3(
+            1.0f / diagonal[0], 1.0f / diagonal[4], 1.0f / diagonal[8]);
+    }
+}
+
+void ImplicitSolver::AddBlock(int block, const float* values, float scale)
+{
+    float* destination = &m_blocks[block * BLOCK_SIZE];
+    for(int i = 0; i < BLOCK_SIZE; ++i)
+    {
+        destination[i] += values[i] * scale;
+    }
+}
+
+int ImplicitSolver::SolveConjugateGradient()
+{
+    const int count = static_cast<int>(m_rhs.size());
+
+    // Starting from zero the residual is the right hand side
+    for(int i = 0; i < count; ++i)
+    {
+        MakeZeroVector(m_deltaVelocity[i]);
+        m_residual[i] = m_rhs[i];
+        m_preconditioned[i] = D3DXVECTOR3(
+            m_residual[i].x * m_inverseDiagonal[i].x,
+            m_residual[i].y * m_inverseDiagonal[i].y,
+            m_residual[i].z * m_inverseDiagonal[i].z);
+        m_direction[i] = m_preconditioned[i];
+    }
+
+    const float threshold = TOLERANCE * TOLERANCE * Dot(m_rhs, m_rhs);
+    float residualDot = Dot(m_residual, m_preconditioned);
+
+    int iteration = 0;
+    while(iteration < MAX_ITERATIONS && Dot(m_residual, m_residual) > threshold)
+    {
+        Multiply(m_direction, m_product);
+
+        const float curvature = Dot(m_direction, m_product);
+        if(curvature <= 0.0f)
+        {
+            break;
+        }
+
+        const float alpha = residualDot / curvature;
+        for(int i = 0; i < count; ++i)
+        {
+            m_deltaVelocity[i] += m_direction[i] * alpha;
+            m_residual[i] -= m_product[i] * alpha;
+            m_preconditioned[i] = D3DXVECTOR3(
+                m_residual[i].x * m_inverseDiagonal[i].x,
+                m_residual[i].y * m_inverseDiagonal[i].y,
+                m_residual[i].z * m_inverseDiagonal[i].z);
+        }
+
+        const float previousDot = residualDot;
+        residualDot = Dot(m_residual, m_preconditioned);
+
+        const float beta = residualDot / previousDot;
+        for(int i = 0; i < count; ++i)
+        {
+            m_direction[i] = m_preconditioned[i] + m_direction[i] * beta;
+        }
+        ++iteration;
+    }
+    return iteration;
+}
+
+void ImplicitSolver::Multiply(const VectorArray& vector, VectorArray& result)
+{
+    const int rows = static_cast<int>(vector.size());
+    if(rows < MIN_PARALLEL_ROWS)
+    {
+        MultiplyRows(vector, result, 0, rows);
+    }
+    else
+    {
+        // Each row writes only its own result so the split needs no locking
+        m_threads.ParallelFor(rows, [&](int begin, int end)
+            { MultiplyRows(vector, result, begin, end); });
+    }
+}
+
+void ImplicitSolver::MultiplyRows(const VectorArray& vector,
+                                  VectorArray& result,
+                                  int begin,
+                                  int end) const
+{
+    for(int i = begin; i < end; ++i)
+    {
+        D3DXVECTOR3 sum(0.0f, 0.0f, 0.0f);
+        for(int j = m_rowStart[i]; j < m_rowStart[i+1]; ++j)
+        {
+            sum += MultiplyBlock(&m_blocks[j * BLOCK_SIZE], vector[m_columns[j]]);
+        }
+        result[i] = sum;
+    }
+}
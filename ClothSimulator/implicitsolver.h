@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - implicitsolver.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+#include "springkernel.h"
+
+class ParticleStore;
+class ThreadPool;
+
+/**
+* Steps the cloth with implicit backward Euler integration by solving the linearised
+* spring forces for the change in velocity with a preconditioned conjugate gradient
+* Reference from 'Large Steps in Cloth Simulation' by David Baraff and Andrew Witkin
+*/
+class ImplicitSolver
+{
+public:
+
+    typedef std::vector<D3DXVECTOR3, AlignedAllocator<D3DXVECTOR3>> VectorArray;
+
+    /**
+    * Constructor
+    * @param threads The threads to split the matrix multiplication between
+    */
+    explicit ImplicitSolver(ThreadPool& threads);
+
+    /**
+    * Builds the sparse block structure of the system from the springs
+    * @param springs The packed data for all springs
+    * @param particleCount The number of particles
+    */
+    void Initialise(const PackedSprings& springs, int particleCount);
+
+    /**
+    * Moves the particles forward one step
+    * @note pinned and colliding particles are held in place for the step
+    * @param springs The packed data for all springs
+    * @param particles The simulated state of all particles
+    * @param stiffnesses The stiffness for each type of spring
+    * @param bend Whether the bend springs are solved
+    * @param timestep The time to step forward
+    * @param damping The damping to apply to the velocity
+    */
+    void Step(const PackedSprings& springs, ParticleStore& particles,
+        const float* stiffnesses, bool bend, float timestep, float damping);
+
+    /**
+    * @return the conjugate gradient iterations used by the last step
+    */
+    int GetIterations() const { return m_iterations; }
+
+private:
+
+    /**
+    * Prevent copying
+    */
+    ImplicitSolver(const ImplicitSolver&) = delete;
+    ImplicitSolver& operator=(const ImplicitSolver&) = delete;
+
+    /**
+    * Fills the system matrix and right hand side for the step
+    * @param springs The packed data for all springs
+    * @param particles The simulated state of all particles
+    * @param stiffnesses The stiffness for each type of spring
+    * @param bend Whether the bend springs are solved
+    * @param timestep The time to step forward
+    */
+    void Assemble(const PackedSprings& springs, const ParticleStore& particles,
+        const float* stiffnesses, bool bend, float timestep);
+
+    /**
+    * Solves the system for the change in velocity
+    * @return the number of iterations used
+    */
+    int SolveConjugateGradient();
+
+    /**
+    * Multiplies the system matrix by a vector
+    * @param vector The vector to multiply
+    * @param result Filled with the result of the multiplication
+    */
+    void Multiply(const VectorArray& vector, VectorArray& result);
+
+    /**
+    * Multiplies a range of block rows of the system matrix by a vector
+    * @param vector The vector to multiply
+    * @param result Filled with the result of the multiplication
+    * @param begin/end The range of block rows
+    */
+    void MultiplyRows(const VectorArray& vector, VectorArray& result, int begin, int end) const;
+
+    /**
+    * Adds a scaled 3x3 block onto a block of the system matrix
+    * @param block The index of the block in the system matrix
+    * @param values The nine values of the block to add
+    * @param scale The amount to scale the values by
+    */
+    void AddBlock(int block, const float* values, float scale);
+
+    ThreadPool& m_threads;         ///< Threads to split the matrix multiplication between
+    int m_iterations;              ///< Conjugate gradient iterations used by the last step
+    IndexArray m_rowStart;         ///< Start of each block row in the columns and blocks
+    IndexArray m_columns;          ///< Block column of each stored block
+    IndexArray m_diagonal;         ///< Index of the diagonal block for each row
+    IndexArray m_springBlocks;     ///< Index of the two off-diagonal blocks for each spring
+    FloatArray m_blocks;           ///< Nine row-major values for each stored block
+    FloatArray m_fixed;            ///< One if the particle is held in place this step
+    VectorArray m_velocity;        ///< Velocity of each particle at the start of the step
+    VectorArray m_rhs;             ///< Right hand side of the system
+    VectorArray m_deltaVelocity;   ///< Solved change in velocity
+    VectorArray m_residual;        ///< Conjugate gradient residual
+    VectorArray m_direction;       ///< Conjugate gradient search direction
+    VectorArray m_product;         ///< Matrix multiplied by the search direction
+    VectorArray m_preconditioned;  ///< Preconditioned residual
+    VectorArray m_inverseDiagonal; ///< Inverse of the diagonal of the system matrix
+};
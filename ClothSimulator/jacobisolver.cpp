@@ -0,0 +1,145 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - jacobisolver.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "jacobisolver.h"
+#include "particlestore.h"
+#include "threadpool.h"
+
+namespace
+{
+    const float RELAXATION = 1.5f;      ///< Initial over-relaxation of the averaged corrections
+    const int MIN_PARALLEL_ITEMS = 512; ///< Smallest range worth splitting across threads
+}
+
+JacobiSolver::JacobiSolver(ThreadPool& threads) :
+    m_threads(threads),
+    m_relaxation(RELAXATION)
+{
+}
+
+void JacobiSolver::Initialise(const PackedSprings& springs, int particleCount)
+{
+    const int springCount = static_cast<int>(springs.rest.size());
+    m_errors.resize(springCount);
+
+    // Count the springs of each type for each particle then prefix sum into 
+    // start offsets; each particle lists its springs grouped by type
+    const int runCount = static_cast<int>(springs.typeStart.size()) - 1;
+    const int listCount = particleCount * Spring::MAX_TYPES;
+    m_adjacencyStart.assign(listCount + 1, 0);
+    for(int run = 0; run < runCount; ++run)
+    {
+        const int type = run % Spring::MAX_TYPES;
+        for(int i = springs.typeStart[run]; i < springs.typeStart[run+1]; ++i)
+        {
+            ++m_adjacencyStart[(springs.index1[i] * Spring::MAX_TYPES) + type + 1];
+            ++m_adjacencyStart[(springs.index2[i] * Spring::MAX_TYPES) + type + 1];
+        }
+    }
+    for(int i = 1; i <= listCount; ++i)
+    {
+        m_adjacencyStart[i] += m_adjacencyStart[i-1];
+    }
+
+    IndexArray fill(m_adjacencyStart.begin(), m_adjacencyStart.end()-1);
+    m_adjacency.resize(springCount * 2);
+    for(int run = 0; run < runCount; ++run)
+    {
+        const int type = run % Spring::MAX_TYPES;
+        for(int i = springs.typeStart[run]; i < springs.typeStart[run+1]; ++i)
+        {
+            m_adjacency[fill[(springs.index1[i] * Spring::MAX_TYPES) + type]++] = i << 1;
+            m_adjacency[fill[(springs.index2[i] * Spring::MAX_TYPES) + type]++] = (i << 1) | 1;
+        }
+    }
+}
+
+void JacobiSolver::Solve(const PackedSprings& springs, 
+                         ParticleStore& particles, 
+                         int iterations,
+                         bool bend)
+{
+    const int springCount = static_cast<int>(m_errors.size());
+    const int particleCount = (static_cast<int>(m_adjacencyStart.size()) - 1) / Spring::MAX_TYPES;
+
+    const std::function<void(int, int)> errorFn = [&](int begin, int end)
+        { CalculateErrors(springs, particles, begin, end); };
+
+    const std::function<void(int, int)> correctionFn = [&](int begin, int end)
+        { ApplyCorrections(springs, particles, bend, begin, end); };
+
+    // Both passes only write to data owned by their item so need no locking
+    for(int i = 0; i < iterations; ++i)
+    {
+        Run(springCount, errorFn);
+        Run(particleCount, correctionFn);
+    }
+}
+
+void JacobiSolver::Run(int count, const std::function<void(int, int)>& work)
+{
+    if(count < MIN_PARALLEL_ITEMS)
+    {
+        work(0, count);
+    }
+    else
+    {
+        m_threads.ParallelFor(count, work);
+    }
+}
+
+void JacobiSolver::CalculateErrors(const PackedSprings& springs,
+                                   const ParticleStore& particles,
+                                   int begin,
+                                   int end)
+{
+    for(int i = begin; i < end; ++i)
+    {
+        const D3DXVECTOR3 difference = particles.GetPosition(springs.index2[i])
+            - particles.GetPosition(springs.index1[i]);
+
+        const float distance = D3DXVec3Length(&difference);
+        m_errors[i] = difference - ((difference / distance) * springs.rest[i]);
+    }
+}
+
+void JacobiSolver::ApplyCorrections(const PackedSprings& springs,
+                                    ParticleStore& particles,
+                                    bool bend,
+                                    int begin,
+                                    int end)
+{
+    // Bend springs are listed last for each particle so are left out by ending early
+    const int types = bend ? Spring::MAX_TYPES : Spring::BEND;
+    for(int i = begin; i < end; ++i)
+    {
+        const int list = i * Spring::MAX_TYPES;
+        const int count = m_adjacencyStart[list + types] - m_adjacencyStart[list];
+        if(count == 0 || particles.GetInverseMass(i) == 0.0f)
+        {
+            continue;
+        }
+
+        D3DXVECTOR3 correction(0.0f, 0.0f, 0.0f);
+        for(int type = 0; type < types; ++type)
+        {
+            D3DXVECTOR3 typeCorrection(0.0f, 0.0f, 0.0f);
+            for(int j = m_adjacencyStart[list + type]; j < m_adjacencyStart[list + type + 1]; ++j)
+            {
+                const int spring = m_adjacency[j] >> 1;
+                if(m_adjacency[j] & 1)
+                {
+                    typeCorrection -= m_errors[spring] * (1.0f - springs.weight[spring]);
+                }
+                else
+                {
+                    typeCorrection += m_errors[spring] * springs.weight[spring];
+                }
+            }
+            correction += typeCorrection * GetSpringCorrection(static_cast<Spring::Type>(type));
+        }
+
+        particles.MovePosition(i, correction * (m_relaxation / count));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - jacobisolver.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+#include "springkernel.h"
+
+class ParticleStore;
+class ThreadPool;
+
+/**
+* Solves the cloth springs by computing all corrections from the same
+* positions then averaging them per particle in a single sweep
+*/
+class JacobiSolver
+{
+public:
+
+    typedef std::vector<D3DXVECTOR3, AlignedAllocator<D3DXVECTOR3>> VectorArray;
+
+    /**
+    * Constructor
+    * @param threads The threads to split the solve between
+    */
+    explicit JacobiSolver(ThreadPool& threads);
+
+    /**
+    * Builds the springs of each type connected to each particle
+    * @param springs The packed data for all springs
+    * @param particleCount The number of particles
+    */
+    void Initialise(const PackedSprings& springs, int particleCount);
+
+    /**
+    * Solves the springs
+    * @param springs The packed data for all springs
+    * @param particles The simulated state of all particles
+    * @param iterations The number of solver iterations
+    * @param bend Whether the bend springs are solved
+    */
+    void Solve(const PackedSprings& springs, ParticleStore& particles, int iterations, bool bend);
+
+    /**
+    * @param relaxation The amount to scale the averaged corrections by
+    */
+    void SetRelaxation(float relaxation) { m_relaxation = relaxation; }
+
+    /**
+    * @return the amount to scale the averaged corrections by
+    */
+    float GetRelaxation() const { return m_relaxation; }
+
+private:
+
+    /**
+    * Prevent copying
+    */
+    JacobiSolver(const JacobiSolver&) = delete;
+    JacobiSolver& operator=(const JacobiSolver&) = delete;
+
+    /**
+    * Calculates the error for a range of springs from the current positions
+    * @param springs The packed data for all springs
+    * @param particles The simulated state of all particles
+    * @param begin/end The range of springs to calculate
+    */
+    void CalculateErrors(const PackedSprings& springs,
+        const ParticleStore& particles, int begin, int end);
+
+    /**
+    * Averages and applies the spring corrections for a range of particles
+    * @param springs The packed data for all springs
+    * @param particles The simulated state of all particles
+    * @param bend Whether the bend springs are solved
+    * @param begin/end The range of particles to correct
+    */
+    void ApplyCorrections(const PackedSprings& springs,
+        ParticleStore& particles, bool bend, int begin, int end);
+
+    /**
+    * Runs work over a range, splitting it between threads if large enough
+    * @param count The amount of items in the range
+    * @param work The work to run on each chunk of the range
+    */
+    void Run(int count, const std::function<void(int, int)>& work);
+
+    ThreadPool& m_threads;        ///< Threads to split the solve between
+    float m_relaxation;           ///< Amount to scale the averaged corrections by
+    VectorArray m_errors;         ///< Error for each spring this iteration
+    IndexArray m_adjacencyStart;  ///< Start of each particle's springs of each type in the adjacency
+    IndexArray m_adjacency;       ///< Springs for each particle with the particle's side in the lowest bit
+};
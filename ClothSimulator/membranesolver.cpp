@@ -0,0 +1,236 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - membranesolver.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "membranesolver.h"
+#include "particlestore.h"
+#include "threadpool.h"
+
+namespace
+{
+    const int MIN_PARALLEL_TRIANGLES = 512; ///< Smallest triangle batch worth splitting across threads
+    const int BATCH_WINDOW = 32;            ///< Triangle batches found in each pass with a bit for each
+    const float MIN_REST_SIZE = 1.0e-6f;    ///< Smallest rest edge or height of a triangle with a shape
+    const float MIN_STRETCH = 1.0e-8f;      ///< Smallest deformed size before a collapsed triangle is skipped
+    const float PINNED_MASS = 1.0e6f;       ///< Inverse of the smallest inverse mass used for fitting
+}
+
+MembraneSolver::MembraneSolver(ThreadPool& threads) :
+    m_threads(threads)
+{
+}
+
+void MembraneSolver::Initialise(const ParticleStore& particles, const std::vector<int>& triangles)
+{
+    const int particleCount = particles.Size();
+    const int triangleCount = static_cast<int>(triangles.size()) / POINTS_IN_FACE;
+
+    // The rest shape is measured in the plane of the triangle with the first
+    // edge along x, leaving a 2x2 upper triangular matrix of the edges. Triangles
+    // collapsed to a line or point have no shape to return to and are skipped
+    std::vector<int> shapes;
+    std::vector<D3DXVECTOR3> restShapes;
+    shapes.reserve(triangleCount);
+    restShapes.reserve(triangleCount);
+    for(int i = 0; i < triangleCount; ++i)
+    {
+        const int* indices = &triangles[i * POINTS_IN_FACE];
+        const D3DXVECTOR3& position = particles.GetPosition(indices[0]);
+        const D3DXVECTOR3 edge1 = particles.GetPosition(indices[1]) - position;
+        const D3DXVECTOR3 edge2 = particles.GetPosition(indices[2]) - position;
+
+        const float edge = D3DXVec3Length(&edge1);
+        if(edge < MIN_REST_SIZE)
+        {
+            continue;
+        }
+
+        const float offset = D3DXVec3Dot(&edge1, &edge2) / edge;
+        const float height = std::sqrt(max(0.0f, D3DXVec3LengthSq(&edge2) - (offset * offset)));
+        if(height < MIN_REST_SIZE)
+        {
+            continue;
+        }
+
+        shapes.push_back(i);
+        restShapes.emplace_back(edge, offset, height);
+    }
+    const int shapeCount = static_cast<int>(shapes.size());
+
+    // Greedily give each triangle the lowest batch not already used by its particles.
+    // Mesh vertices may be shared by any number of triangles, so batches are found a 
+    // window at a time with a bit for each and triangles whose particles have filled
+    // the window wait for the next one
+    std::vector<unsigned int> particleBatches(particleCount);
+    std::vector<int> triangleBatch(shapeCount, NO_INDEX);
+    m_batchStart.assign(1, 0);
+    int remaining = shapeCount;
+
+    for(int window = 0; remaining > 0; window += BATCH_WINDOW)
+    {
+        std::fill(particleBatches.begin(), particleBatches.end(), 0);
+        for(int i = 0; i < shapeCount; ++i)
+        {
+            const int* indices = &triangles[shapes[i] * POINTS_IN_FACE];
+            const unsigned int used = particleBatches[indices[0]] |
+                particleBatches[indices[1]] | particleBatches[indices[2]];
+            if(triangleBatch[i] != NO_INDEX || used == ~0u)
+            {
+                continue;
+            }
+
+            int batch = 0;
+            while(used & (1u << batch))
+            {
+                ++batch;
+            }
+
+            for(int j = 0; j < POINTS_IN_FACE; ++j)
+            {
+                particleBatches[indices[j]] |= 1u << batch;
+            }
+            triangleBatch[i] = window + batch;
+            --remaining;
+
+            if(triangleBatch[i]+2 > static_cast<int>(m_batchStart.size()))
+            {
+                m_batchStart.resize(triangleBatch[i]+2, 0);
+            }
+            ++m_batchStart[triangleBatch[i]+1];
+        }
+    }
+    for(unsigned int i = 1; i < m_batchStart.size(); ++i)
+    {
+        m_batchStart[i] += m_batchStart[i-1];
+    }
+
+    m_index0.resize(shapeCount);
+    m_index1.resize(shapeCount);
+    m_index2.resize(shapeCount);
+    m_restEdge.resize(shapeCount);
+    m_restOffset.resize(shapeCount);
+    m_restHeight.resize(shapeCount);
+    m_inverseEdge.resize(shapeCount);
+    m_inverseOffset.resize(shapeCount);
+    m_inverseHeight.resize(shapeCount);
+
+    std::vector<int> fill(m_batchStart.begin(), m_batchStart.end()-1);
+    for(int i = 0; i < shapeCount; ++i)
+    {
+        const int* indices = &triangles[shapes[i] * POINTS_IN_FACE];
+        const float edge = restShapes[i].x;
+        const float offset = restShapes[i].y;
+        const float height = restShapes[i].z;
+
+        const int index = fill[triangleBatch[i]]++;
+        m_index0[index] = indices[0];
+        m_index1[index] = indices[1];
+        m_index2[index] = indices[2];
+        m_restEdge[index] = edge;
+        m_restOffset[index] = offset;
+        m_restHeight[index] = height;
+        m_inverseEdge[index] = 1.0f / edge;
+        m_inverseOffset[index] = -offset / (edge * height);
+        m_inverseHeight[index] = 1.0f / height;
+    }
+}
+
+void MembraneSolver::ScaleRestShapes(float scale)
+{
+    const int triangleCount = GetTriangleCount();
+    for(int i = 0; i < triangleCount; ++i)
+    {
+        m_restEdge[i] *= scale;
+        m_restOffset[i] *= scale;
+        m_restHeight[i] *= scale;
+        m_inverseEdge[i] /= scale;
+        m_inverseOffset[i] /= scale;
+        m_inverseHeight[i] /= scale;
+    }
+}
+
+void MembraneSolver::Solve(ParticleStore& particles, float stiffness)
+{
+    // Triangles in a batch share no particles and can be solved in any order
+    const int batchCount = static_cast<int>(m_batchStart.size())-1;
+    for(int batch = 0; batch < batchCount; ++batch)
+    {
+        const int start = m_batchStart[batch];
+        const int count = m_batchStart[batch+1] - start;
+
+        if(count < MIN_PARALLEL_TRIANGLES)
+        {
+            SolveRange(particles, stiffness, start, start+count);
+        }
+        else
+        {
+            m_threads.ParallelFor(count, [&, start](int begin, int end)
+                { SolveRange(particles, stiffness, start+begin, start+end); });
+        }
+    }
+}
+
+void MembraneSolver::SolveRange(ParticleStore& particles, float stiffness, int begin, int end) const
+{
+    const float* inverseMass = particles.GetInverseMasses();
+
+    for(int i = begin; i < end; ++i)
+    {
+        const int index0 = m_index0[i];
+        const int index1 = m_index1[i];
+        const int index2 = m_index2[i];
+        const D3DXVECTOR3 position0 = particles.GetPosition(index0);
+        const D3DXVECTOR3 position1 = particles.GetPosition(index1);
+        const D3DXVECTOR3 position2 = particles.GetPosition(index2);
+
+        // Deformation gradient mapping the rest plane onto the deformed triangle
+        const D3DXVECTOR3 edge1 = position1 - position0;
+        const D3DXVECTOR3 edge2 = position2 - position0;
+        const D3DXVECTOR3 gradient0 = edge1 * m_inverseEdge[i];
+        const D3DXVECTOR3 gradient1 = (edge1 * m_inverseOffset[i]) + (edge2 * m_inverseHeight[i]);
+
+        // The rotation is F(F'F)^-1/2 where the square root of the 2x2 F'F is
+        // (F'F + sI) / sqrt(trace + 2s) with s the square root of its determinant
+        const float s00 = D3DXVec3Dot(&gradient0, &gradient0);
+        const float s01 = D3DXVec3Dot(&gradient0, &gradient1);
+        const float s11 = D3DXVec3Dot(&gradient1, &gradient1);
+        const float root = std::sqrt(max(0.0f, (s00 * s11) - (s01 * s01)));
+        const float denominator = root * std::sqrt(s00 + s11 + (2.0f * root));
+        if(denominator < MIN_STRETCH)
+        {
+            continue;
+        }
+
+        const float inverse = 1.0f / denominator;
+        const D3DXVECTOR3 axisX = ((gradient0 * (s11 + root)) - (gradient1 * s01)) * inverse;
+        const D3DXVECTOR3 axisY = ((gradient1 * (s00 + root)) - (gradient0 * s01)) * inverse;
+
+        // Rest positions about the rest centroid rotated to the deformed triangle
+        const float edge = m_restEdge[i];
+        const float offset = m_restOffset[i];
+        const float height = m_restHeight[i];
+        const float centreX = (edge + offset) / 3.0f;
+        const float centreY = height / 3.0f;
+        const D3DXVECTOR3 rest0 = (axisX * -centreX) + (axisY * -centreY);
+        const D3DXVECTOR3 rest1 = (axisX * (edge - centreX)) + (axisY * -centreY);
+        const D3DXVECTOR3 rest2 = (axisX * (offset - centreX)) + (axisY * (height - centreY));
+
+        // The rotated rest shape is placed at the mass weighted fit of the
+        // particles so pinned particles pull the shape onto themselves
+        const float weight0 = inverseMass[index0];
+        const float weight1 = inverseMass[index1];
+        const float weight2 = inverseMass[index2];
+        const float mass0 = 1.0f / (weight0 + (1.0f / PINNED_MASS));
+        const float mass1 = 1.0f / (weight1 + (1.0f / PINNED_MASS));
+        const float mass2 = 1.0f / (weight2 + (1.0f / PINNED_MASS));
+        const D3DXVECTOR3 centre = ((position0 - rest0) * mass0 + (position1 - rest1) * mass1 +
+            (position2 - rest2) * mass2) / (mass0 + mass1 + mass2);
+
+        particles.SetPosition(index0, position0 +
+            (centre + rest0 - position0) * (stiffness * weight0 * mass0));
+        particles.SetPosition(index1, position1 +
+            (centre + rest1 - position1) * (stiffness * weight1 * mass1));
+        particles.SetPosition(index2, position2 +
+            (centre + rest2 - position2) * (stiffness * weight2 * mass2));
+    }
+}
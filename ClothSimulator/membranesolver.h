@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - membranesolver.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "springkernel.h"
+
+class ParticleStore;
+class ThreadPool;
+
+/**
+* Co-rotational linear finite element membrane over the cloth triangles
+* Each triangle resists stretch and shear through the deformation of its
+* rest shape once rotation is removed, replacing the stretch and shear springs
+*/
+class MembraneSolver
+{
+public:
+
+    /**
+    * Constructor
+    * @param threads The threads to split the solve between
+    */
+    explicit MembraneSolver(ThreadPool& threads);
+
+    /**
+    * Measures the rest shape of each triangle and groups them into batches
+    * @param particles The simulated state of all particles at rest
+    * @param triangles Three particle indices for each triangle
+    */
+    void Initialise(const ParticleStore& particles, const std::vector<int>& triangles);
+
+    /**
+    * Scales the rest shape of every triangle
+    * @param scale The amount to scale by
+    */
+    void ScaleRestShapes(float scale);
+
+    /**
+    * Moves the particles of each triangle towards its rest shape rotated to fit
+    * @param particles The simulated state of all particles
+    * @param stiffness The fraction of the way to move towards the rest shape
+    */
+    void Solve(ParticleStore& particles, float stiffness);
+
+    /**
+    * @return the number of triangles in the membrane
+    */
+    int GetTriangleCount() const { return static_cast<int>(m_index0.size()); }
+
+private:
+
+    /**
+    * Prevent copying
+    */
+    MembraneSolver(const MembraneSolver&) = delete;
+    MembraneSolver& operator=(const MembraneSolver&) = delete;
+
+    /**
+    * Solves a range of triangles which share no particles
+    * @param particles The simulated state of all particles
+    * @param stiffness The fraction of the way to move towards the rest shape
+    * @param begin/end The range of triangles to solve
+    */
+    void SolveRange(ParticleStore& particles, float stiffness, int begin, int end) const;
+
+    ThreadPool& m_threads;          ///< Threads to split the solve between
+    std::vector<int> m_batchStart;  ///< Start of each batch of triangles sharing no particles
+    IndexArray m_index0;            ///< Index of the first particle for each triangle
+    IndexArray m_index1;            ///< Index of the second particle for each triangle
+    IndexArray m_index2;            ///< Index of the third particle for each triangle
+    FloatArray m_restEdge;          ///< Rest length of the first edge along the triangle x axis
+    FloatArray m_restOffset;        ///< Rest x coordinate of the third particle
+    FloatArray m_restHeight;        ///< Rest y coordinate of the third particle
+    FloatArray m_inverseEdge;       ///< First column of the inverse rest shape
+    FloatArray m_inverseOffset;     ///< Top of the second column of the inverse rest shape
+    FloatArray m_inverseHeight;     ///< Bottom of the second column of the inverse rest shape
+};
@@ -0,0 +1,243 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - multigridsolver.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "multigridsolver.h"
+#include "particlestore.h"
+#include "gridlayout.h"
+#include <algorithm>
+
+namespace
+{
+    const int MIN_LEVEL_ROWS = 3;      ///< Fewest rows a coarse level can have
+    const int INTERPOLATION_SOURCES = 4; ///< Coarse particles each target is interpolated from
+
+    /**
+    * @param rows The number of rows of the full resolution grid
+    * @param stride The amount of full resolution rows between each level row
+    * @return the full resolution rows used by the level including the last row
+    */
+    std::vector<int> GetLevelRows(int rows, int stride)
+    {
+        std::vector<int> levelRows;
+        for(int row = 0; row < rows; row += stride)
+        {
+            levelRows.push_back(row);
+        }
+        if(levelRows.back() != rows-1)
+        {
+            levelRows.push_back(rows-1);
+        }
+        return levelRows;
+    }
+
+    /**
+    * Finds the level rows either side of a row and how far it is between them
+    * @param levelRows The rows used by the level
+    * @param row The row to find
+    * @param lower/upper Filled with the position of the rows in the level either side
+    * @return the fraction of the way from the lower to the upper row
+    */
+    float FindBracket(const std::vector<int>& levelRows, int row, int& lower, int& upper)
+    {
+        upper = static_cast<int>(std::lower_bound(levelRows.begin(), levelRows.end(), row) - levelRows.begin());
+        if(levelRows[upper] == row)
+        {
+            lower = upper;
+            return 0.0f;
+        }
+        lower = upper-1;
+        return static_cast<float>(row - levelRows[lower]) / (levelRows[upper] - levelRows[lower]);
+    }
+}
+
+MultigridSolver::MultigridSolver()
+{
+}
+
+void MultigridSolver::Initialise(const ParticleStore& particles, const GridLayout& layout)
+{
+    m_levels.clear();
+    const int rows = layout.GetRows();
+
+    // Cloth without grid rows such as imported meshes only uses the fine level
+    if(rows < MIN_LEVEL_ROWS)
+    {
+        return;
+    }
+
+    std::vector<int> fineRows = GetLevelRows(rows, 1);
+    for(int stride = 2; ; stride *= 2)
+    {
+        const std::vector<int> levelRows = GetLevelRows(rows, stride);
+        const int count = static_cast<int>(levelRows.size());
+        if(count < MIN_LEVEL_ROWS || count == static_cast<int>(fineRows.size()))
+        {
+            break;
+        }
+
+        m_levels.emplace_back();
+        Level& level = m_levels.back();
+
+        auto getParticle = [&](int column, int row)
+            { return layout.GetParticle(levelRows[column], levelRows[row]); };
+
+        for(int column = 0; column < count; ++column)
+        {
+            for(int row = 0; row < count; ++row)
+            {
+                level.particles.push_back(getParticle(column, row));
+            }
+        }
+        level.snapshot.resize(level.particles.size());
+
+        auto addSpring = [&](int index1, int index2)
+        {
+            const D3DXVECTOR3 difference = particles.GetPosition(index2) - particles.GetPosition(index1);
+            level.index1.push_back(index1);
+            level.index2.push_back(index2);
+            level.rest.push_back(D3DXVec3Length(&difference));
+        };
+
+        // Stretch and shear springs across each cell of the level
+        for(int column = 0; column < count; ++column)
+        {
+            for(int row = 0; row < count; ++row)
+            {
+                if(row+1 < count)
+                {
+                    addSpring(getParticle(column, row), getParticle(column, row+1));
+                }
+                if(column+1 < count)
+                {
+                    addSpring(getParticle(column, row), getParticle(column+1, row));
+                }
+                if(row+1 < count && column+1 < count)
+                {
+                    addSpring(getParticle(column, row), getParticle(column+1, row+1));
+                    addSpring(getParticle(column, row+1), getParticle(column+1, row));
+                }
+            }
+        }
+
+        // Particles on the finer level but not this one are bilinearly interpolated
+        for(int fineColumn : fineRows)
+        {
+            int column0 = 0, column1 = 0;
+            const float u = FindBracket(levelRows, fineColumn, column0, column1);
+
+            for(int fineRow : fineRows)
+            {
+                int row0 = 0, row1 = 0;
+                const float v = FindBracket(levelRows, fineRow, row0, row1);
+                if(column0 == column1 && row0 == row1)
+                {
+                    continue;
+                }
+
+                level.targets.push_back(layout.GetParticle(fineColumn, fineRow));
+                level.sources.push_back(column0 * count + row0);
+                level.sources.push_back(column1 * count + row0);
+                level.sources.push_back(column0 * count + row1);
+                level.sources.push_back(column1 * count + row1);
+                level.weights.push_back((1.0f-u) * (1.0f-v));
+                level.weights.push_back(u * (1.0f-v));
+                level.weights.push_back((1.0f-u) * v);
+                level.weights.push_back(u * v);
+            }
+        }
+
+        fineRows = levelRows;
+    }
+}
+
+void MultigridSolver::ScaleRestDistances(float scale)
+{
+    for(Level& level : m_levels)
+    {
+        for(float& rest : level.rest)
+        {
+            rest *= scale;
+        }
+    }
+}
+
+void MultigridSolver::Solve(ParticleStore& particles, const SmoothFn& smoothFine, int cycles)
+{
+    for(int i = 0; i < cycles; ++i)
+    {
+        Cycle(particles, smoothFine, 0);
+    }
+}
+
+void MultigridSolver::Cycle(ParticleStore& particles, const SmoothFn& smoothFine, int level)
+{
+    auto smooth = [&]()
+    {
+        if(level == 0)
+        {
+            smoothFine();
+        }
+        else
+        {
+            SolveLevel(particles, m_levels[level-1]);
+        }
+    };
+
+    smooth();
+
+    if(level < static_cast<int>(m_levels.size()))
+    {
+        // Coarse particles are shared with this level so restriction is their
+        // current position; only the change from solving them is prolonged
+        Level& coarse = m_levels[level];
+        for(unsigned int i = 0; i < coarse.particles.size(); ++i)
+        {
+            coarse.snapshot[i] = particles.GetPosition(coarse.particles[i]);
+        }
+
+        Cycle(particles, smoothFine, level+1);
+        Prolong(particles, coarse);
+    }
+
+    smooth();
+}
+
+void MultigridSolver::SolveLevel(ParticleStore& particles, const Level& level) const
+{
+    const int count = static_cast<int>(level.rest.size());
+    for(int i = 0; i < count; ++i)
+    {
+        const int index1 = level.index1[i];
+        const int index2 = level.index2[i];
+        const D3DXVECTOR3 difference = particles.GetPosition(index2) - particles.GetPosition(index1);
+        const float length = D3DXVec3Length(&difference);
+
+        // Compressed coarse springs are left alone so the finer levels can fold
+        if(length > level.rest[i])
+        {
+            const D3DXVECTOR3 error = difference - ((difference / length) * level.rest[i]);
+            particles.MovePosition(index1, error * 0.5f);
+            particles.MovePosition(index2, -error * 0.5f);
+        }
+    }
+}
+
+void MultigridSolver::Prolong(ParticleStore& particles, Level& level) const
+{
+    for(unsigned int i = 0; i < level.particles.size(); ++i)
+    {
+        level.snapshot[i] = particles.GetPosition(level.particles[i]) - level.snapshot[i];
+    }
+
+    const int count = static_cast<int>(level.targets.size());
+    for(int i = 0; i < count; ++i)
+    {
+        D3DXVECTOR3 correction(0.0f, 0.0f, 0.0f);
+        for(int j = i * INTERPOLATION_SOURCES; j < (i+1) * INTERPOLATION_SOURCES; ++j)
+        {
+            correction += level.snapshot[level.sources[j]] * level.weights[j];
+        }
+        particles.MovePosition(level.targets[i], correction);
+    }
+}
@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - multigridsolver.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+#include "springkernel.h"
+#include <functional>
+
+class ParticleStore;
+class GridLayout;
+
+/**
+* Solves the cloth springs with V-cycles over coarser grids built from every
+* second row and column so stretch across the whole cloth is corrected in
+* few iterations. Coarse levels only resist stretching to allow folding.
+* Reference from 'Hierarchical Position Based Dynamics' by Matthias Muller
+*/
+class MultigridSolver
+{
+public:
+
+    typedef std::function<void(void)> SmoothFn;
+
+    /**
+    * Constructor
+    */
+    MultigridSolver();
+
+    /**
+    * Builds the coarse levels from the particle grid
+    * @param particles The simulated state of all particles at rest
+    * @param layout The grid the particles are stored in
+    */
+    void Initialise(const ParticleStore& particles, const GridLayout& layout);
+
+    /**
+    * Scales the rest distance of the coarse springs for a uniformly scaled cloth
+    * @param scale The amount to scale by
+    */
+    void ScaleRestDistances(float scale);
+
+    /**
+    * Solves the springs
+    * @param particles The simulated state of all particles
+    * @param smoothFine Solves one iteration of the full resolution springs
+    * @param cycles The number of V-cycles to run
+    */
+    void Solve(ParticleStore& particles, const SmoothFn& smoothFine, int cycles);
+
+    /**
+    * @return the number of levels including the full resolution grid
+    */
+    int GetLevelCount() const { return static_cast<int>(m_levels.size()) + 1; }
+
+private:
+
+    /**
+    * Prevent copying
+    */
+    MultigridSolver(const MultigridSolver&) = delete;
+    MultigridSolver& operator=(const MultigridSolver&) = delete;
+
+    /**
+    * Grid of a subset of the particles coarser than the level before it
+    */
+    struct Level
+    {
+        IndexArray particles;   ///< Particle indices on this level
+        IndexArray index1;      ///< Index of the first particle for each coarse spring
+        IndexArray index2;      ///< Index of the second particle for each coarse spring
+        FloatArray rest;        ///< Distance for each coarse spring at rest
+        IndexArray targets;     ///< Particles on the finer level but not on this level
+        IndexArray sources;     ///< Four positions into the particles to interpolate each target from
+        FloatArray weights;     ///< Four bilinear weights to interpolate each target with
+        std::vector<D3DXVECTOR3> snapshot; ///< Positions of the particles before solving the level
+    };
+
+    /**
+    * Runs a V-cycle from the level down to the coarsest level
+    * @param particles The simulated state of all particles
+    * @param smoothFine Solves one iteration of the full resolution springs
+    * @param level The level to start from; zero is the full resolution grid
+    */
+    void Cycle(ParticleStore& particles, const SmoothFn& smoothFine, int level);
+
+    /**
+    * Solves the springs of a coarse level, only correcting stretching
+    * @param particles The simulated state of all particles
+    * @param level The coarse level to solve
+    */
+    void SolveLevel(ParticleStore& particles, const Level& level) const;
+
+    /**
+    * Moves the particles only on the finer level by the
+    * interpolated correction of the particles on the coarse level
+    * @param particles The simulated state of all particles
+    * @param level The coarse level to interpolate from
+    */
+    void Prolong(ParticleStore& particles, Level& level) const;
+
+    std::vector<Level> m_levels; ///< Coarse levels from finest to coarsest
+};
@@ -9,9 +9,11 @@
 
 class Diagnostic;
 class Shader;
+class ParticleStore;
 
 /**
 * A sphere representing a vertex on the cloth
+* The simulated state is held in the particle store at the particle's index
 */
 class Particle
 {
@@ -20,19 +22,17 @@ public:
     /**
     * Constructor
     * @param engine Callbacks from the rendering engine
+    * @param store The simulated state of all particles
     */
-    explicit Particle(EnginePtr engine);
+    Particle(EnginePtr engine, ParticleStore& store);
 
     /**
-    * Create the particle
-    * @param position The intial position of the particle
-    * @param uv The uvs for the particle
+    * Create the particle from its initialised state in the store
     * @param index The internal index of the particle
     * @param mesh The template collision mesh to copy
     * @param visualRadius The radius to render the markers 
     */
-    void Initialise(const D3DXVECTOR3& position, const D3DXVECTOR2& uv, 
-        unsigned int index, const CollisionMesh& mesh, float visualRadius);
+    void Initialise(unsigned int index, const CollisionMesh& mesh, float visualRadius);
 
     /**
     * Draws the particle visual mesh
@@ -69,7 +69,7 @@ public:
     /**
     * @return whether particle is pinned
     */
-    bool IsPinned() const { return m_pinned; };
+    bool IsPinned() const;
 
     /**
     * @param pin Set whether the particle is pinned
@@ -79,7 +79,7 @@ public:
     /**
     * @return whether particle is selected
     */
-    bool IsSelected() const { return m_selected; };
+    bool IsSelected() const;
 
     /**
     * @param select Set whether particle is selected
@@ -92,11 +92,6 @@ public:
     */
     void MovePosition(const D3DXVECTOR3& position);
 
-    /**
-    * @return whether the particle should undergo smoothing or not
-    */
-    bool RequiresSmoothing() const;
-
     /**
     * @return the internal index of the particle
     */
@@ -105,19 +100,12 @@ public:
     /**
     * @return the position of the particle in world coordinates
     */
-    const D3DXVECTOR3& GetPosition() const { return m_position; }
-
-    /**
-    * @return the uvs for the particle
-    */
-    const D3DXVECTOR2& GetUVs() const { return m_uvs; }
+    const D3DXVECTOR3& GetPosition() const;
 
     /**
-    * Update the particles position
-    * @param damping The damping to apply to the movement
-    * @param timestepSqr Delta time squared
+    * Updates the particle's collision with the cached position
     */
-    void PreCollisionUpdate(float damping, float timestepSqr);
+    void UpdateCollisionPosition();
 
     /**
     * Sets the colour of the visual particle mesh
@@ -127,6 +115,7 @@ public:
 
     /**
     * Updates the required values post collision resolution
+    * and caches the collision state in the particle store
     */
     void PostCollisionUpdate();
 
@@ -138,36 +127,16 @@ public:
 
 private:
 
-    /**
-    * Updates the particle's collision with the cached position
-    */
-    void UpdateCollisionPosition();
-
-    /**
-    * Filters the y component of the position delta
-    * @note this is to prevent jittering of the convex hull algorithm
-    * and can be removed once Persistent contact caching is in place
-    */
-    void FilterPosition();
-
     /**
     * Prevent copying
     */
     Particle(const Particle&);
     Particle& operator=(const Particle&);
              
+    ParticleStore& m_store;                      ///< Simulated state of all particles
     D3DXVECTOR3 m_positionDelta;                 ///< Change in position between current and previous positions
-    D3DXVECTOR3 m_previousPosition;              ///< Current previous position this tick
-    D3DXVECTOR3 m_position;                      ///< Current position in world coordinates of particle
-    D3DXVECTOR3 m_acceleration;                  ///< Current acceleration of particle
-    D3DXVECTOR3 m_initialPosition;               ///< Initial position of particle 
-    D3DXVECTOR2 m_uvs;                           ///< Texture uvs for the particle
-    Transform m_transform;                       ///< Current transform of particle
-    bool m_selected;                             ///< Whether particle is selected or not
-    bool m_pinned;                               ///< Whether particle is pinned or not
     unsigned int m_index;                        ///< Internal index of the particle
     D3DXVECTOR3 m_color;                         ///< Color of the particle
     std::shared_ptr<DynamicMesh> m_collision;    ///< collision geometry for particle
     float m_visualRadius;                        ///< Visual render radius for particle markers
-    std::deque<float> m_yFiltering;              ///< Filtering of the y component for position
 };
\ No newline at end of file
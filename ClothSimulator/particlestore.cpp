@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - particlestore.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "particlestore.h"
+
+namespace
+{
+    const float PARTICLE_MASS = 1.0f;  ///< Mass in kg for single particle
+}
+
+ParticleStore::ParticleStore() :
+    m_pinChanges(0)
+{
+}
+
+void ParticleStore::Resize(int count)
+{
+    m_position.resize(count);
+    m_previousPosition.resize(count);
+    m_acceleration.resize(count);
+    m_initialPosition.resize(count);
+    m_interactingVelocity.resize(count);
+    m_inverseMass.resize(count);
+    m_flags.resize(count);
+}
+
+void ParticleStore::Initialise(int index, const D3DXVECTOR3& position)
+{
+    m_position[index] = position;
+    m_previousPosition[index] = position;
+    m_initialPosition[index] = position;
+    MakeZeroVector(m_acceleration[index]);
+    MakeZeroVector(m_interactingVelocity[index]);
+
+    // Pins and the handle row are kept for particles surviving a rebuild
+    m_flags[index] &= PINNED | SELECTED;
+    m_inverseMass[index] = HasFlag(index, PINNED) ? 0.0f : 1.0f / PARTICLE_MASS;
+}
+
+void ParticleStore::ResetPosition(int index)
+{
+    m_previousPosition[index] = m_position[index] = m_initialPosition[index];
+}
+
+void ParticleStore::AddForce(const D3DXVECTOR3& force)
+{
+    const int count = Size();
+    for(int i = 0; i < count; ++i)
+    {
+        m_acceleration[i] += force * m_inverseMass[i];
+    }
+}
+
+void ParticleStore::Integrate(float damping, float timestepSqr)
+{
+    const int count = Size();
+    for(int i = 0; i < count; ++i)
+    {
+        if(m_inverseMass[i] != 0.0f && !(m_flags[i] & COLLIDING))
+        {
+            //verlet integration
+            //X(t + dt) = 2X(t) - X(t - dt) + dt^2X''(t)
+            //X(t + dt) = X(t) + (X(t)-X(t - dt)) + dt^2X''(t)
+            //X(t + dt) = X(t) + X'(t) + dt^2X''(t)
+            const D3DXVECTOR3 update = ((m_position[i]-m_previousPosition[i])*damping)
+                + (m_acceleration[i]*timestepSqr);
+
+            m_previousPosition[i] = m_position[i];
+            m_position[i] += update;
+        }
+        else
+        {
+            m_previousPosition[i] = m_position[i];
+        }
+    }
+}
+
+void ParticleStore::ClearAccelerations()
+{
+    for(D3DXVECTOR3& acceleration : m_acceleration)
+    {
+        MakeZeroVector(acceleration);
+    }
+}
+
+void ParticleStore::SetFlag(int index, Flag flag, bool set)
+{
+    if(set)
+    {
+        m_flags[index] |= flag;
+    }
+    else
+    {
+        m_flags[index] &= ~flag;
+    }
+}
+
+void ParticleStore::SetPinned(int index, bool pin)
+{
+    if(HasFlag(index, PINNED) != pin)
+    {
+        ++m_pinChanges;
+    }
+    SetFlag(index, PINNED, pin);
+    SetFlag(index, SLEEPING, false);
+    m_inverseMass[index] = pin ? 0.0f : 1.0f / PARTICLE_MASS;
+}
+
+void ParticleStore::SetSleeping(int index, bool sleep)
+{
+    SetFlag(index, SLEEPING, sleep);
+    m_inverseMass[index] = sleep || HasFlag(index, PINNED) ? 0.0f : 1.0f / PARTICLE_MASS;
+    if(sleep)
+    {
+        m_previousPosition[index] = m_position[index];
+    }
+}
\ No newline at end of file
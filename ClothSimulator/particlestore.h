@@ -0,0 +1,224 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - particlestore.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+#include "alignedallocator.h"
+
+/**
+* Contiguous storage for the simulated state of all cloth particles
+* Each attribute lives in its own aligned array accessed by particle index
+*/
+class ParticleStore
+{
+public:
+
+    typedef std::vector<D3DXVECTOR3, AlignedAllocator<D3DXVECTOR3>> VectorArray;
+    typedef std::vector<float, AlignedAllocator<float>> FloatArray;
+    typedef std::vector<unsigned char, AlignedAllocator<unsigned char>> FlagArray;
+
+    /**
+    * State flags for a particle
+    */
+    enum Flag
+    {
+        PINNED = 1,       ///< Particle cannot move
+        SELECTED = 2,     ///< Particle is part of the handle mode row
+        COLLIDING = 4,    ///< Particle collided with a scene object last tick
+        HULL_CONTACT = 8, ///< Particle collided with a box or cylinder last tick
+        SLEEPING = 16     ///< Particle is at rest and held in place until woken
+    };
+
+    /**
+    * Constructor
+    */
+    ParticleStore();
+
+    /**
+    * Sets the amount of particles stored
+    * @param count The amount of particles
+    */
+    void Resize(int count);
+
+    /**
+    * @return the amount of particles stored
+    */
+    int Size() const { return static_cast<int>(m_position.size()); }
+
+    /**
+    * Sets the initial state of a particle
+    * @param index The index of the particle
+    * @param position The initial position of the particle
+    * @note any pinned or selected state of the particle is kept
+    */
+    void Initialise(int index, const D3DXVECTOR3& position);
+
+    /**
+    * Resets a particle back to its initial position
+    * @param index The index of the particle
+    */
+    void ResetPosition(int index);
+
+    /**
+    * Verlet integrates all particles that are free to move
+    * @note accelerations are kept until cleared to allow substepping
+    * @param damping The damping to apply to the movement
+    * @param timestepSqr Delta time squared
+    */
+    void Integrate(float damping, float timestepSqr);
+
+    /**
+    * Removes the acceleration accumulated for all particles
+    */
+    void ClearAccelerations();
+
+    /**
+    * Adds a force to all particles
+    * @param force The force to add
+    */
+    void AddForce(const D3DXVECTOR3& force);
+
+    /**
+    * Adds a force to a particle
+    * @param index The index of the particle
+    * @param force The force to add
+    */
+    void AddForce(int index, const D3DXVECTOR3& force)
+    {
+        m_acceleration[index] += force * m_inverseMass[index];
+    }
+
+    /**
+    * Moves a particle explicitly if it is not pinned
+    * @param index The index of the particle
+    * @param translation The amount to move by
+    */
+    void MovePosition(int index, const D3DXVECTOR3& translation)
+    {
+        if(m_inverseMass[index] != 0.0f)
+        {
+            m_position[index] += translation;
+        }
+    }
+
+    /**
+    * Sets the position of a particle
+    * @param index The index of the particle
+    * @param position The position in world coordinates
+    */
+    void SetPosition(int index, const D3DXVECTOR3& position) { m_position[index] = position; }
+
+    /**
+    * @param index The index of the particle
+    * @return the position of the particle in world coordinates
+    */
+    const D3DXVECTOR3& GetPosition(int index) const { return m_position[index]; }
+
+    /**
+    * @param index The index of the particle
+    * @return the position of the particle last tick
+    */
+    const D3DXVECTOR3& GetPreviousPosition(int index) const { return m_previousPosition[index]; }
+
+    /**
+    * @param index The index of the particle
+    * @return the position the particle resets to
+    */
+    const D3DXVECTOR3& GetInitialPosition(int index) const { return m_initialPosition[index]; }
+
+    /**
+    * @param index The index of the particle
+    * @param position The position of the particle last tick
+    */
+    void SetPreviousPosition(int index, const D3DXVECTOR3& position) { m_previousPosition[index] = position; }
+
+    /**
+    * @param index The index of the particle
+    * @return the acceleration accumulated for the particle this tick
+    */
+    const D3DXVECTOR3& GetAcceleration(int index) const { return m_acceleration[index]; }
+
+    /**
+    * @param index The index of the particle
+    * @return the inverse mass of the particle; zero if pinned or asleep
+    */
+    float GetInverseMass(int index) const { return m_inverseMass[index]; }
+
+    /**
+    * @param index The index of the particle
+    * @return the velocity of any colliding meshes interacting with the particle
+    */
+    const D3DXVECTOR3& GetInteractingVelocity(int index) const { return m_interactingVelocity[index]; }
+
+    /**
+    * @param index The index of the particle
+    * @param velocity The velocity of any colliding meshes interacting with the particle
+    */
+    void SetInteractingVelocity(int index, const D3DXVECTOR3& velocity) { m_interactingVelocity[index] = velocity; }
+
+    /**
+    * @param index The index of the particle
+    * @param flag The flag to query
+    * @return whether the flag is set for the particle
+    */
+    bool HasFlag(int index, Flag flag) const { return (m_flags[index] & flag) != 0; }
+
+    /**
+    * @param index The index of the particle
+    * @param flag The flag to change
+    * @param set Whether to set or clear the flag
+    */
+    void SetFlag(int index, Flag flag, bool set);
+
+    /**
+    * @note pinning or unpinning a particle also wakes it
+    * @param index The index of the particle
+    * @param pin Whether the particle is pinned
+    */
+    void SetPinned(int index, bool pin);
+
+    /**
+    * Sleeping particles are held in place with no velocity until woken
+    * @param index The index of the particle
+    * @param sleep Whether the particle is asleep
+    */
+    void SetSleeping(int index, bool sleep);
+
+    /**
+    * @return a count increased each time any particle is pinned or unpinned
+    */
+    int GetPinChanges() const { return m_pinChanges; }
+
+    /**
+    * @return the position array of all particles
+    */
+    const VectorArray& GetPositions() const { return m_position; }
+
+    /**
+    * @return the x, y, z components of all particle positions packed together
+    */
+    float* GetPositionComponents() { return &m_position[0].x; }
+
+    /**
+    * @return the inverse mass of all particles
+    */
+    const float* GetInverseMasses() const { return &m_inverseMass[0]; }
+
+private:
+
+    /**
+    * Prevent copying
+    */
+    ParticleStore(const ParticleStore&);
+    ParticleStore& operator=(const ParticleStore&);
+
+    VectorArray m_position;             ///< Current position in world coordinates
+    VectorArray m_previousPosition;     ///< Position at the start of the last tick
+    VectorArray m_acceleration;         ///< Acceleration accumulated this tick
+    VectorArray m_initialPosition;      ///< Position to reset to
+    VectorArray m_interactingVelocity;  ///< Velocity of colliding meshes last tick
+    FloatArray m_inverseMass;           ///< One over the mass; zero if pinned or asleep
+    FlagArray m_flags;                  ///< State flags for the particles
+    int m_pinChanges;                   ///< Times any particle has been pinned or unpinned
+};
@@ -6,49 +6,39 @@
 #include <algorithm>
 #include <assert.h>
 
-Face::Face() :
-    normal(0.0f, 0.0f, 0.0f),
-    distanceToOrigin(0.0f),
-    index(0),
-    alive(true)
+Simplex::Simplex() :
+    m_pointCount(0),
+    m_faceCount(0),
+    m_edgeCount(0),
+    m_heapSize(0)
 {
-    indices.assign(0);
-}
-
-Edge::Edge()
-{
-    indices.assign(0);
-}
-
-Simplex::Simplex()
-{
-    const int maximumExpectedEdges = 20;
-    m_edges.reserve(maximumExpectedEdges);
 }
 
 bool Simplex::IsLine() const
 {
-    return m_simplex.size() == POINTS_IN_EDGE;
+    return m_pointCount == POINTS_IN_EDGE;
 }
 
 bool Simplex::IsTetrahedron() const
 {
-    return m_simplex.size() == POINTS_IN_TETRAHEDRON;
+    return m_pointCount == POINTS_IN_TETRAHEDRON;
 }
 
 bool Simplex::IsTriPlane() const
 {
-    return m_simplex.size() == POINTS_IN_FACE;
+    return m_pointCount == POINTS_IN_FACE;
 }
 
 void Simplex::RemovePoint(const D3DXVECTOR3& point)
 {
-    m_simplex.erase(std::remove(m_simplex.begin(), m_simplex.end(), point), m_simplex.end()); 
+    m_pointCount = static_cast<int>(std::remove(m_simplex.begin(), 
+        m_simplex.begin() + m_pointCount, point) - m_simplex.begin());
 }
 
 void Simplex::AddPoint(const D3DXVECTOR3& point)
 {
-    m_simplex.push_back(point);
+    assert(m_pointCount < MAX_SIMPLEX_POINTS);
+    m_simplex[m_pointCount++] = point;
 }
 
 const D3DXVECTOR3& Simplex::GetPoint(int index) const
@@ -56,16 +46,12 @@ const D3DXVECTOR3& Simplex::GetPoint(int index) const
     return m_simplex[index];
 }
 
-const std::deque<D3DXVECTOR3>& Simplex::GetPoints() const
-{
-    return m_simplex;
-}
-
 void Simplex::GenerateFaces()
 {
     auto createFace = [this](int face, int i0, int i1, int i2, 
         const D3DXVECTOR3& u, const D3DXVECTOR3& v)
     {
+        m_faces[face].alive = true;
         m_faces[face].index = face;
         m_faces[face].indices[0] = i0;
         m_faces[face].indices[1] = i1;
@@ -83,10 +69,12 @@ void Simplex::GenerateFaces()
 
         m_faces[face].distanceToOrigin = GetDistanceToOrigin(m_faces[face]);
         assert(m_faces[face].distanceToOrigin >= 0.0f);
+        PushFace(face);
     };
 
-    assert(m_simplex.size() <= POINTS_IN_TETRAHEDRON);
-    m_faces.resize(POINTS_IN_TETRAHEDRON);
+    assert(m_pointCount == POINTS_IN_TETRAHEDRON);
+    m_faceCount = POINTS_IN_TETRAHEDRON;
+    m_heapSize = 0;
 
     const int A = 3;
     const int B = 0;
@@ -117,60 +105,75 @@ void Simplex::ExtendFace(const D3DXVECTOR3& point)
     // on the border of the highlighted ones. Reference:
     // http://www.eecs.tufts.edu/~mhorn01/comp163/algorithm.html
 
-    const int pointIndex = static_cast<int>(m_simplex.size());
-    m_simplex.push_back(point);
-    m_edges.clear();
+    assert(m_pointCount < MAX_SIMPLEX_POINTS);
+    m_edgeCount = 0;
 
     // Determine faces that the point is in front of
-    std::vector<int> visibleFaces;
-    for(const Face& face : m_faces)
+    std::array<int, MAX_SIMPLEX_FACES> visibleFaces;
+    int visibleCount = 0;
+    for(int i = 0; i < m_faceCount; ++i)
     {
+        const Face& face = m_faces[i];
         if(face.alive)
         {
             D3DXVECTOR3 faceToPoint = point - GetPoint(face.indices[0]);
             if(D3DXVec3Dot(&face.normal, &faceToPoint) > 0.0f)
             {
-                visibleFaces.push_back(face.index);
+                visibleFaces[visibleCount++] = face.index;
             }
         }
     }
-    assert(!visibleFaces.empty());
+    assert(visibleCount > 0);
 
     // Find all border edges from the visible faces
     const int minimumFaces = 1;
-    if(visibleFaces.size() == minimumFaces)
+    if(visibleCount == minimumFaces)
     {
         // For a single face, all edges are on the border
         for(const Edge& edge : m_faces[visibleFaces[0]].edges)
         {
-            m_edges.push_back(edge);
+            m_edges[m_edgeCount++] = edge;
         }
     }
     else
     {
         // For multiple faces, determine the border edges
-        for(int index : visibleFaces)
+        for(int i = 0; i < visibleCount; ++i)
         {
-            FindBorderEdges(m_faces[index], visibleFaces);
+            FindBorderEdges(m_faces[visibleFaces[i]], &visibleFaces[0], visibleCount);
         }
     }
-    assert(!m_edges.empty());
+    assert(m_edgeCount > 0);
+
+    // A convex hull always has room for the new faces though
+    // a point almost on a face may give a broken border
+    if(m_pointCount == MAX_SIMPLEX_POINTS || 
+       m_edgeCount - visibleCount > MAX_SIMPLEX_FACES - m_heapSize)
+    {
+        return;
+    }
+
+    const int pointIndex = m_pointCount;
+    m_simplex[m_pointCount++] = point;
 
     // Mark all visible faces as dead
-    for(int index : visibleFaces)
+    for(int i = 0; i < visibleCount; ++i)
     {
-        m_faces[index].alive = false;
+        m_faces[visibleFaces[i]].alive = false;
+        RemoveFace(visibleFaces[i]);
     }
     
     // Connect up new faces from the edges to the point
-    unsigned int visibleIndex = 0;
+    int visibleIndex = 0;
     bool hasDeadFaces = true;
     
-    for(const Edge& edge : m_edges)
+    for(int i = 0; i < m_edgeCount; ++i)
     {
+        const Edge& edge = m_edges[i];
+
         // Determine a new face to overwrite/create
         int faceIndex = NO_INDEX;
-        if(visibleIndex < visibleFaces.size())
+        if(visibleIndex < visibleCount)
         {
             faceIndex = visibleFaces[visibleIndex];
             ++visibleIndex;
@@ -185,8 +188,7 @@ void Simplex::ExtendFace(const D3DXVECTOR3& point)
         
             if(!hasDeadFaces)
             {
-                faceIndex = m_faces.size();
-                m_faces.emplace_back();
+                faceIndex = m_faceCount++;
             }
         }
     
@@ -217,19 +219,22 @@ void Simplex::ExtendFace(const D3DXVECTOR3& point)
             face.distanceToOrigin = fabs(face.distanceToOrigin);
             face.normal = -face.normal;
         }
+        PushFace(faceIndex);
     }
 }
 
 int Simplex::GetDeadFaceIndex() const
 {
-    auto itr = std::find_if(m_faces.begin(), m_faces.end(), 
+    auto end = m_faces.begin() + m_faceCount;
+    auto itr = std::find_if(m_faces.begin(), end, 
         [](const Face& face){ return !face.alive; });
 
-    return itr == m_faces.end() ? NO_INDEX : itr->index;
+    return itr == end ? NO_INDEX : itr->index;
 }
 
 void Simplex::FindBorderEdges(const Face& face, 
-                              const std::vector<int>& faces)
+                              const int* faces,
+                              int count)
 {
     // Can have a maximum of 2 border edges per face
     int borderCounter = 0;
@@ -237,10 +242,10 @@ void Simplex::FindBorderEdges(const Face& face,
 
     for(const Edge& edge : face.edges)
     {
-        if(!IsSharedEdge(face.index, edge, faces))
+        if(!IsSharedEdge(face.index, edge, faces, count))
         {
             ++borderCounter;
-            m_edges.push_back(edge);
+            m_edges[m_edgeCount++] = edge;
             if(borderCounter >= maxBorders)
             {
                 return;
@@ -249,11 +254,11 @@ void Simplex::FindBorderEdges(const Face& face,
     }
 }
 
-bool Simplex::IsSharedEdge(int index, const Edge& edge, const std::vector<int>& faces) const
+bool Simplex::IsSharedEdge(int index, const Edge& edge, const int* faces, int count) const
 {
-    for(int faceindex : faces)
+    for(int i = 0; i < count; ++i)
     {
-        const Face& face = m_faces[faceindex];
+        const Face& face = m_faces[faces[i]];
         if(face.index == index || !face.alive)
         {
             continue;
@@ -299,16 +304,76 @@ D3DXVECTOR3 Simplex::GetFaceCenter(int faceindex) const
     return center;
 }
 
-const Face& Simplex::GetClosestFaceToOrigin()
+const Face& Simplex::GetClosestFaceToOrigin() const
+{
+    assert(m_heapSize > 0);
+    return m_faces[m_heap[0]];
+}
+
+void Simplex::PushFace(int index)
+{
+    m_heap[m_heapSize] = index;
+    m_heapPosition[index] = m_heapSize;
+    SiftUp(m_heapSize++);
+}
+
+void Simplex::RemoveFace(int index)
 {
-    int closest = 0;
-    for(unsigned int i = 0; i < m_faces.size(); ++i)
+    // Replace the face with the last entry and move that into place
+    const int position = m_heapPosition[index];
+    SwapHeap(position, --m_heapSize);
+    if(position < m_heapSize)
     {
-        if(m_faces[i].alive && m_faces[i].distanceToOrigin
-            < m_faces[closest].distanceToOrigin)
+        SiftUp(position);
+        SiftDown(position);
+    }
+}
+
+void Simplex::SiftUp(int position)
+{
+    while(position > 0)
+    {
+        const int parent = (position - 1) / 2;
+        if(m_faces[m_heap[parent]].distanceToOrigin <= 
+           m_faces[m_heap[position]].distanceToOrigin)
+        {
+            break;
+        }
+        SwapHeap(position, parent);
+        position = parent;
+    }
+}
+
+void Simplex::SiftDown(int position)
+{
+    for(;;)
+    {
+        int closest = position;
+        const int left = (position * 2) + 1;
+        const int right = left + 1;
+
+        if(left < m_heapSize && m_faces[m_heap[left]].distanceToOrigin <
+            m_faces[m_heap[closest]].distanceToOrigin)
+        {
+            closest = left;
+        }
+        if(right < m_heapSize && m_faces[m_heap[right]].distanceToOrigin <
+            m_faces[m_heap[closest]].distanceToOrigin)
         {
-            closest = i;
+            closest = right;
         }
+        if(closest == position)
+        {
+            break;
+        }
+        SwapHeap(position, closest);
+        position = closest;
     }
-    return m_faces[closest];
+}
+
+void Simplex::SwapHeap(int positionA, int positionB)
+{
+    std::swap(m_heap[positionA], m_heap[positionB]);
+    m_heapPosition[m_heap[positionA]] = positionA;
+    m_heapPosition[m_heap[positionB]] = positionB;
 }
\ No newline at end of file
@@ -4,19 +4,18 @@
 
 #pragma once
 #include "common.h"
-#include <deque>
 #include <array>
 
+static const int MAX_SIMPLEX_EXTENSIONS = 10; ///< Most points a tetrahedron simplex can be extended by
+static const int MAX_SIMPLEX_POINTS = POINTS_IN_TETRAHEDRON + MAX_SIMPLEX_EXTENSIONS;
+static const int MAX_SIMPLEX_FACES = (MAX_SIMPLEX_POINTS * 2) - 4; ///< Faces of a convex hull of the most points
+static const int MAX_SIMPLEX_EDGES = MAX_SIMPLEX_FACES * 2;        ///< Border edges of the most visible faces
+
 /**
 * Edge between faces of a n-dimensional simplex
 */
 struct Edge
 {
-    /**
-    * Constructor
-    */
-    Edge();
-
     std::array<int, POINTS_IN_EDGE> indices; ///< Index for simplex points
 };
 
@@ -25,11 +24,6 @@ struct Edge
 */
 struct Face
 {
-    /**
-    * Constructor
-    */
-    Face();
-
     bool alive;                              ///< Whether the triangle is dead
     int index;                               ///< User index of face
     D3DXVECTOR3 normal;                      ///< Normal of the face
@@ -41,6 +35,7 @@ struct Face
 /**
 * Holds points an n-dimensional simplex
 * For tetrahedron+ can generate and hold face information
+* @note all storage is held inline so building and extending never allocates
 */
 class Simplex
 {
@@ -81,11 +76,11 @@ public:
     * @return The point at the given index
     */
     const D3DXVECTOR3& GetPoint(int index) const;
-   
+
     /**
-    * @return the list of all points
+    * @return the number of points in the simplex
     */
-    const std::deque<D3DXVECTOR3>& GetPoints() const;
+    int GetPointCount() const { return m_pointCount; }
 
     /**
     * Generates the initial faces of a terminating simplex
@@ -96,18 +91,31 @@ public:
     /**
     * Connects the vertices of the current face with the given point
     * @param point The point to extend to
+    * @note leaves the simplex unchanged if it has no room for the new faces
     */
     void ExtendFace(const D3DXVECTOR3& point);
 
     /**
-    * @return the last generated border edges for the simplex
+    * @return the number of border edges last generated for the simplex
+    */
+    int GetBorderEdgeCount() const { return m_edgeCount; }
+
+    /**
+    * @param index The index of the border edge
+    * @return the border edge last generated for the simplex
+    */
+    const Edge& GetBorderEdge(int index) const { return m_edges[index]; }
+
+    /**
+    * @return the number of faces for the simplex including any dead faces
     */
-    const std::vector<Edge>& GetBorderEdges() const { return m_edges; }
+    int GetFaceCount() const { return m_faceCount; }
 
     /**
-    * @return the faces for the simplex
+    * @param index The index of the face
+    * @return the face for the simplex
     */
-    const std::deque<Face>& GetFaces() const { return m_faces; }
+    const Face& GetFace(int index) const { return m_faces[index]; }
 
     /**
     * @param faceindex The index for the face
@@ -119,7 +127,7 @@ public:
     * Finds the closest triangle face to the origin point
     * @return The closest face within the simplex to the origin
     */
-    const Face& GetClosestFaceToOrigin();
+    const Face& GetClosestFaceToOrigin() const;
 
 private:
 
@@ -140,24 +148,62 @@ private:
     * Determines if the given edge exists among the comparison faces
     * @param index The face index the edge lives on
     * @param edge The edge to check for
-    * @param comparison A list of faces indices to search for the edge
+    * @param faces The faces indices to search for the edge
+    * @param count The number of faces to search
     * @return whether the given edge is shared amongst the given faces
     */
-    bool IsSharedEdge(int index, const Edge& edge, const std::vector<int>& faces) const;
+    bool IsSharedEdge(int index, const Edge& edge, const int* faces, int count) const;
 
     /**
-    * Fills the given container with any edges from the face that are border edges
+    * Fills the border edges with any edges from the face that are border edges
     * @param face The face to find the border edges for
     * @param faces All possible connected faces to the face
+    * @param count The number of connected faces
     */
-    void FindBorderEdges(const Face& face, const std::vector<int>& faces);
+    void FindBorderEdges(const Face& face, const int* faces, int count);
 
     /**
     * @return an index of a dead face
     */
     int GetDeadFaceIndex() const;
 
-    std::vector<Edge> m_edges; ///< Found border edges for hull generation
-    std::deque<Face> m_faces; ///< faces for tetrahedron+ simplex points
-    std::deque<D3DXVECTOR3> m_simplex; ///< Internal simplex container
+    /**
+    * Adds a live face to the heap ordered by distance to the origin
+    * @param index The index of the face
+    */
+    void PushFace(int index);
+
+    /**
+    * Removes a face from the heap ordered by distance to the origin
+    * @param index The index of the face
+    */
+    void RemoveFace(int index);
+
+    /**
+    * Moves a heap entry towards the root until its parent is closer
+    * @param position The position in the heap to move
+    */
+    void SiftUp(int position);
+
+    /**
+    * Moves a heap entry towards the leaves until its children are further
+    * @param position The position in the heap to move
+    */
+    void SiftDown(int position);
+
+    /**
+    * Swaps two heap entries and the positions the faces record
+    * @param positionA/positionB The positions in the heap to swap
+    */
+    void SwapHeap(int positionA, int positionB);
+
+    int m_pointCount; ///< Number of points in the simplex
+    int m_faceCount;  ///< Number of faces used including dead faces
+    int m_edgeCount;  ///< Number of border edges last found
+    int m_heapSize;   ///< Number of live faces in the heap
+    std::array<D3DXVECTOR3, MAX_SIMPLEX_POINTS> m_simplex; ///< Internal simplex container
+    std::array<Face, MAX_SIMPLEX_FACES> m_faces;           ///< faces for tetrahedron+ simplex points
+    std::array<Edge, MAX_SIMPLEX_EDGES> m_edges;           ///< Found border edges for hull generation
+    std::array<int, MAX_SIMPLEX_FACES> m_heap;             ///< Live faces as a min-heap by distance to origin
+    std::array<int, MAX_SIMPLEX_FACES> m_heapPosition;     ///< Position of each live face in the heap
 };
\ No newline at end of file
@@ -14,6 +14,7 @@
 #include "scene.h"
 #include "octree.h"
 #include "collisionsolver.h"
+#include "benchmark.h"
 #include <algorithm>
 #include <sstream>
 
@@ -22,6 +23,8 @@ namespace
     const float CAMERA_MOVE_SPEED = 40.0f;  ///< Speed the camera will translate
     const float CAMERA_ROT_SPEED = 2.0f;    ///< Speed the camera will rotate
     const float HANDLE_SPEED = 20.0f;       ///< Speed the cloth will move in handle mode
+    const float PHYSICS_STEP = 1.0f / 60.0f; ///< Fixed deltatime for each physics step
+    const int MAX_PHYSICS_STEPS = 3;        ///< Most physics steps to catch up with in one frame
 
     const D3DCOLOR BACK_BUFFER_COLOR(D3DCOLOR_XRGB(190, 190, 195)); 
     const D3DCOLOR RENDER_COLOR(D3DCOLOR_XRGB(0, 0, 255));          
@@ -30,6 +33,7 @@ namespace
 
 Simulation::Simulation() :
     m_drawCollisions(false),
+    m_accumulatedTime(0.0f),
     m_d3ddev(nullptr)
 {
 }
@@ -83,19 +87,41 @@ void Simulation::Update()
         m_input->SolvePicking();
     }
 
-    const float deltatime = m_timer->GetDeltaTime();
     const bool pressed = m_input->IsClickPreventionActive() 
         ? false : m_input->IsMousePressed();
 
-    m_cloth->PreCollisionUpdate(deltatime);
+    // Physics runs in fixed steps so its cost and stability do not depend on the 
+    // frame rate. Time the steps cannot catch up with in a frame is dropped
+    m_accumulatedTime += m_timer->GetDeltaTime();
+    int steps = 0;
+    while(m_accumulatedTime >= PHYSICS_STEP && steps < MAX_PHYSICS_STEPS)
+    {
+        UpdatePhysics(pressed);
+        m_accumulatedTime -= PHYSICS_STEP;
+        ++steps;
+    }
+    m_accumulatedTime = min(m_accumulatedTime, PHYSICS_STEP);
+
+    m_cloth->UpdateRenderState(m_accumulatedTime / PHYSICS_STEP);
+
+    if(m_diagnostics->AllowDiagnostics(Diagnostic::TEXT))
+    {
+        m_diagnostics->UpdateText(Diagnostic::TEXT,
+            "PhysicsSteps", Diagnostic::WHITE, StringCast(steps));
+    }
+
+    D3DPERF_EndEvent();
+}
+
+void Simulation::UpdatePhysics(bool pressed)
+{
+    m_cloth->PreCollisionUpdate(PHYSICS_STEP);
     m_scene->PreCollisionUpdate(pressed, m_input->GetMouseDirection(),
-        m_camera->World(), m_camera->InverseProjection(), deltatime);
+        m_camera->World(), m_camera->InverseProjection(), PHYSICS_STEP);
 
     m_scene->SolveCollisions();
     m_cloth->PostCollisionUpdate();
     m_scene->PostCollisionUpdate();
-
-    D3DPERF_EndEvent();
 }
 
 void Simulation::LoadGuiCallbacks(GuiCallbacks* callbacks)
@@ -171,6 +197,7 @@ bool Simulation::CreateSimulation(HINSTANCE hInstance, HWND hWnd, LPDIRECT3DDEVI
     m_cloth.reset(new Cloth(engine));
     m_solver.reset(new CollisionSolver(engine, m_cloth));
     m_scene.reset(new Scene(engine, m_solver));
+    m_benchmark.reset(new Benchmark(engine, m_cloth, m_solver));
 
     // Hook up the solver to the octree
     octree->SetIteratorFunction(std::bind(&CollisionSolver::SolveObjectCollision, 
@@ -261,6 +288,50 @@ void Simulation::LoadInput(HINSTANCE hInstance, HWND hWnd, EnginePtr engine)
     m_input->SetKeyCallback(DIK_MINUS, true, 
         std::bind(&Cloth::ChangeSmoothing, m_cloth.get(), false));
 
+    // Cloth spring solver
+    m_input->SetKeyCallback(DIK_O, false, 
+        std::bind(&Cloth::ToggleSolver, m_cloth.get()));
+
+    // Cloth particle integrator
+    m_input->SetKeyCallback(DIK_I, false, 
+        std::bind(&Cloth::ToggleIntegrator, m_cloth.get()));
+
+    // Cloth Jacobi solver acceleration
+    m_input->SetKeyCallback(DIK_U, false, 
+        std::bind(&Cloth::ToggleAcceleration, m_cloth.get()));
+
+    // Cloth regions sleeping when at rest
+    m_input->SetKeyCallback(DIK_G, false, 
+        std::bind(&Cloth::ToggleSleeping, m_cloth.get()));
+
+    // Cloth bend springs solved
+    m_input->SetKeyCallback(DIK_B, false, 
+        std::bind(&Cloth::ToggleBendSprings, m_cloth.get()));
+
+    // Cloth long range attachments to the pinned particles
+    m_input->SetKeyCallback(DIK_K, false, 
+        std::bind(&Cloth::ToggleAttachments, m_cloth.get()));
+
+    // Exact box and cylinder collisions rather than GJK and EPA
+    m_input->SetKeyCallback(DIK_H, false, 
+        std::bind(&CollisionSolver::ToggleAnalyticPrimitives, m_solver.get()));
+
+    // Cloth finite element membrane in place of the stretch and shear springs
+    m_input->SetKeyCallback(DIK_M, false, 
+        std::bind(&Cloth::ToggleMembrane, m_cloth.get()));
+
+    // Cloth strain limiting after the spring solve
+    m_input->SetKeyCallback(DIK_J, false, 
+        std::bind(&Cloth::ToggleStrainLimiting, m_cloth.get()));
+
+    // Cloth grid particle storage order
+    m_input->SetKeyCallback(DIK_Y, false, 
+        std::bind(&Cloth::ToggleLayout, m_cloth.get()));
+
+    // Cloth from an imported triangle mesh
+    m_input->SetKeyCallback(DIK_L, false, 
+        std::bind(&Cloth::LoadMesh, m_cloth.get(), ".\\Resources\\Models\\cloth.obj"));
+
     // Setting deltatime explicitly
     m_input->SetKeyCallback(DIK_P, false, 
         std::bind(&Timer::ToggleForceDeltatime, m_timer.get()));
@@ -303,4 +374,41 @@ void Simulation::LoadInput(HINSTANCE hInstance, HWND hWnd, EnginePtr engine)
     // Toggle wall collision model diagnostics
     m_input->SetKeyCallback(DIK_9, false, 
         std::bind(&Scene::ToggleWallVisibility, m_scene.get()));   
+
+    // Performance benchmarks
+    m_input->SetKeyCallback(DIK_F1, false,
+        std::bind(&Benchmark::SelfCollision, m_benchmark.get()));
+
+    m_input->SetKeyCallback(DIK_F2, false,
+        std::bind(&Benchmark::SpringKernels, m_benchmark.get()));
+
+    m_input->SetKeyCallback(DIK_F3, false,
+        std::bind(&Benchmark::SolverConvergence, m_benchmark.get()));
+
+    m_input->SetKeyCallback(DIK_F4, false,
+        std::bind(&Benchmark::ImplicitIntegration, m_benchmark.get()));
+
+    m_input->SetKeyCallback(DIK_F5, false,
+        std::bind(&Benchmark::ChebyshevAcceleration, m_benchmark.get()));
+
+    m_input->SetKeyCallback(DIK_F6, false,
+        std::bind(&Benchmark::RebuildLatency, m_benchmark.get()));
+
+    m_input->SetKeyCallback(DIK_F7, false,
+        std::bind(&Benchmark::ParticleLayout, m_benchmark.get()));
+
+    m_input->SetKeyCallback(DIK_F8, false,
+        std::bind(&Benchmark::LongRangeAttachments, m_benchmark.get()));
+
+    m_input->SetKeyCallback(DIK_F9, false,
+        std::bind(&Benchmark::StrainLimiting, m_benchmark.get()));
+
+    m_input->SetKeyCallback(DIK_F10, false,
+        std::bind(&Benchmark::MembraneModel, m_benchmark.get()));
+
+    m_input->SetKeyCallback(DIK_F11, false,
+        std::bind(&Benchmark::DrapePrimitives, m_benchmark.get()));
+
+    m_input->SetKeyCallback(DIK_F12, false,
+        std::bind(&Benchmark::HullPenetration, m_benchmark.get()));
 }
\ No newline at end of file
@@ -15,6 +15,7 @@ class Cloth;
 class Input;
 class Timer;
 class Octree;
+class Benchmark;
 
 /**
 * Main Simulation Class
@@ -60,6 +61,12 @@ public:
 
 private:
 
+    /**
+    * Moves the simulation forward one fixed physics step
+    * @param pressed Whether the mouse is pressed
+    */
+    void UpdatePhysics(bool pressed);
+
     /**
     * Loads all scene meshes
     * @return whether loading was successful
@@ -90,6 +97,8 @@ private:
     std::unique_ptr<Scene> m_scene;              ///< Mesh manager for the scene
     std::unique_ptr<Diagnostic> m_diagnostics;   ///< Diagnostic renderer
     std::unique_ptr<Octree> m_octree;            ///< Octree spatial partitining
+    std::unique_ptr<Benchmark> m_benchmark;      ///< Timed performance scenarios
     LPDIRECT3DDEVICE9 m_d3ddev;                  ///< DirectX device
     bool m_drawCollisions;                       ///< Whether to display collision models
+    float m_accumulatedTime;                     ///< Frame time not yet simulated by a physics step
 };
@@ -0,0 +1,226 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - sleepregions.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sleepregions.h"
+#include "particlestore.h"
+#include "springkernel.h"
+#include "gridlayout.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+    const int TILE_ROWS = 8;             ///< Rows and columns of grid particles in each region
+    const int MESH_REGION_PARTICLES = 64; ///< Consecutive mesh particles in each region
+    const int SLEEP_TICKS = 30;          ///< Ticks a region must stay still before sleeping
+    const float SLEEP_MOTION = 0.002f;   ///< Largest movement per tick as a fraction of the spacing
+    const float WAKE_MOTION = 0.004f;    ///< Neighbouring movement per tick that wakes a region
+}
+
+SleepRegions::SleepRegions() :
+    m_sleepingCount(0)
+{
+}
+
+void SleepRegions::Initialise(int particleCount, const GridLayout& layout)
+{
+    m_particleRegion.resize(particleCount);
+    int regionCount = 0;
+
+    const int rows = layout.GetRows();
+    if(rows > 0)
+    {
+        const int tiles = (rows + TILE_ROWS - 1) / TILE_ROWS;
+        for(int i = 0; i < particleCount; ++i)
+        {
+            const int cell = layout.GetCell(i);
+            m_particleRegion[i] = ((cell / rows) / TILE_ROWS) * tiles + ((cell % rows) / TILE_ROWS);
+        }
+        regionCount = tiles * tiles;
+    }
+    else
+    {
+        for(int i = 0; i < particleCount; ++i)
+        {
+            m_particleRegion[i] = i / MESH_REGION_PARTICLES;
+        }
+        regionCount = (particleCount + MESH_REGION_PARTICLES - 1) / MESH_REGION_PARTICLES;
+    }
+
+    m_regionStart.assign(regionCount+1, 0);
+    for(int region : m_particleRegion)
+    {
+        ++m_regionStart[region+1];
+    }
+    for(int i = 1; i <= regionCount; ++i)
+    {
+        m_regionStart[i] += m_regionStart[i-1];
+    }
+
+    std::vector<int> next(m_regionStart.begin(), m_regionStart.end()-1);
+    m_regionParticles.resize(particleCount);
+    for(int i = 0; i < particleCount; ++i)
+    {
+        m_regionParticles[next[m_particleRegion[i]]++] = i;
+    }
+
+    m_quietTicks.assign(regionCount, 0);
+    m_motion.assign(regionCount, 0.0f);
+    m_asleep.assign(regionCount, 0);
+    m_settled.assign(regionCount, 0);
+    m_neighbourStart.assign(regionCount+1, 0);
+    m_neighbours.clear();
+    m_sleepingCount = 0;
+}
+
+void SleepRegions::Connect(const PackedSprings& springs)
+{
+    std::vector<std::pair<int, int>> links;
+    for(unsigned int i = 0; i < springs.index1.size(); ++i)
+    {
+        const int region1 = m_particleRegion[springs.index1[i]];
+        const int region2 = m_particleRegion[springs.index2[i]];
+        if(region1 != region2)
+        {
+            links.push_back(std::make_pair(region1, region2));
+            links.push_back(std::make_pair(region2, region1));
+        }
+    }
+    std::sort(links.begin(), links.end());
+    links.erase(std::unique(links.begin(), links.end()), links.end());
+
+    const int regionCount = GetRegionCount();
+    m_neighbourStart.assign(regionCount+1, 0);
+    m_neighbours.resize(links.size());
+    for(unsigned int i = 0; i < links.size(); ++i)
+    {
+        ++m_neighbourStart[links[i].first+1];
+        m_neighbours[i] = links[i].second;
+    }
+    for(int i = 1; i <= regionCount; ++i)
+    {
+        m_neighbourStart[i] += m_neighbourStart[i-1];
+    }
+}
+
+bool SleepRegions::Update(ParticleStore& particles,
+                          const std::vector<D3DXVECTOR3>& tickStart,
+                          float spacing)
+{
+    const float sleepMotion = spacing * SLEEP_MOTION;
+    const float wakeMotion = spacing * WAKE_MOTION;
+    const float sleepMotionSqr = sleepMotion * sleepMotion;
+    const int regionCount = GetRegionCount();
+
+    // A region is disturbed if pushed by a moving mesh or woken directly such as by
+    // being pinned; otherwise its motion is the furthest any particle moved this tick
+    for(int region = 0; region < regionCount; ++region)
+    {
+        float motionSqr = 0.0f;
+        for(int i = m_regionStart[region]; i < m_regionStart[region+1]; ++i)
+        {
+            const int index = m_regionParticles[i];
+            if(!IsZeroVector(particles.GetInteractingVelocity(index)) ||
+                (m_asleep[region] && !particles.HasFlag(index, ParticleStore::SLEEPING)))
+            {
+                motionSqr = FLT_MAX;
+                break;
+            }
+
+            const D3DXVECTOR3 movement = particles.GetPosition(index) - tickStart[index];
+            motionSqr = max(motionSqr, D3DXVec3LengthSq(&movement));
+        }
+
+        m_motion[region] = motionSqr == FLT_MAX ? FLT_MAX : std::sqrt(motionSqr);
+        m_quietTicks[region] = motionSqr > sleepMotionSqr ? 0 : m_quietTicks[region]+1;
+    }
+
+    auto getNeighbourMotion = [this](int region) -> float
+    {
+        float motion = 0.0f;
+        for(int i = m_neighbourStart[region]; i < m_neighbourStart[region+1]; ++i)
+        {
+            motion = max(motion, m_motion[m_neighbours[i]]);
+        }
+        return motion;
+    };
+
+    auto isNeighbourhoodQuiet = [this](int region) -> bool
+    {
+        for(int i = m_neighbourStart[region]; i < m_neighbourStart[region+1]; ++i)
+        {
+            const int neighbour = m_neighbours[i];
+            if(!m_asleep[neighbour] && m_quietTicks[neighbour] < SLEEP_TICKS)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // Sleeping regions wake when disturbed or when next to a moving region so
+    // motion spreads across the cloth; still regions only sleep once their
+    // neighbours have also been still so they do not jerk a moving region.
+    // Waking needs more motion than sleeping so slow regions do not flicker
+    bool changed = false;
+    for(int region = 0; region < regionCount; ++region)
+    {
+        if(m_asleep[region])
+        {
+            if(m_motion[region] == FLT_MAX || getNeighbourMotion(region) > wakeMotion)
+            {
+                SetAsleep(particles, region, false);
+                changed = true;
+            }
+        }
+        else if(m_quietTicks[region] >= SLEEP_TICKS && isNeighbourhoodQuiet(region))
+        {
+            SetAsleep(particles, region, true);
+            changed = true;
+        }
+    }
+
+    if(changed)
+    {
+        UpdateSettled();
+    }
+    return changed;
+}
+
+void SleepRegions::WakeAll(ParticleStore& particles)
+{
+    for(int region = 0; region < GetRegionCount(); ++region)
+    {
+        if(m_asleep[region])
+        {
+            SetAsleep(particles, region, false);
+        }
+    }
+    std::fill(m_settled.begin(), m_settled.end(), 0);
+}
+
+void SleepRegions::SetAsleep(ParticleStore& particles, int region, bool sleep)
+{
+    m_asleep[region] = sleep ? 1 : 0;
+    m_quietTicks[region] = 0;
+    m_sleepingCount += sleep ? 1 : -1;
+
+    for(int i = m_regionStart[region]; i < m_regionStart[region+1]; ++i)
+    {
+        particles.SetSleeping(m_regionParticles[i], sleep);
+    }
+}
+
+void SleepRegions::UpdateSettled()
+{
+    for(int region = 0; region < GetRegionCount(); ++region)
+    {
+        bool settled = m_asleep[region] != 0;
+        for(int i = m_neighbourStart[region]; i < m_neighbourStart[region+1] && settled; ++i)
+        {
+            settled = m_asleep[m_neighbours[i]] != 0;
+        }
+        m_settled[region] = settled ? 1 : 0;
+    }
+}
@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - sleepregions.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+
+class ParticleStore;
+class GridLayout;
+struct PackedSprings;
+
+/**
+* Splits the cloth particles into regions which are put to sleep together
+* once they and their neighbouring regions have stopped moving
+*/
+class SleepRegions
+{
+public:
+
+    /**
+    * Constructor
+    */
+    SleepRegions();
+
+    /**
+    * Splits the particles into square tiles for a grid or index ranges for a mesh
+    * @note mesh particles are ordered so nearby indices are connected
+    * @param particleCount The number of particles
+    * @param layout The grid the particles are stored in; without rows for a mesh cloth
+    */
+    void Initialise(int particleCount, const GridLayout& layout);
+
+    /**
+    * Links regions connected by a spring so motion in one can wake the other
+    * @param springs The packed data for all springs
+    */
+    void Connect(const PackedSprings& springs);
+
+    /**
+    * Updates which regions are asleep from how far their particles moved this tick
+    * @param particles The simulated state of all particles
+    * @param tickStart The particle positions at the start of the tick
+    * @param spacing The rest distance between neighbouring particles
+    * @return whether any region fell asleep or woke
+    */
+    bool Update(ParticleStore& particles,
+        const std::vector<D3DXVECTOR3>& tickStart, float spacing);
+
+    /**
+    * Wakes all regions
+    * @param particles The simulated state of all particles
+    */
+    void WakeAll(ParticleStore& particles);
+
+    /**
+    * @param index The index of the particle
+    * @return the region the particle belongs to
+    */
+    int GetRegion(int index) const { return m_particleRegion[index]; }
+
+    /**
+    * @return the number of regions
+    */
+    int GetRegionCount() const { return static_cast<int>(m_asleep.size()); }
+
+    /**
+    * @return the number of regions asleep
+    */
+    int GetSleepingCount() const { return m_sleepingCount; }
+
+    /**
+    * @param region The region to query
+    * @return whether the particles of the region are asleep
+    */
+    bool IsAsleep(int region) const { return m_asleep[region] != 0; }
+
+    /**
+    * @param region The region to query
+    * @return whether the region and all its neighbouring regions are asleep
+    */
+    bool IsSettled(int region) const { return m_settled[region] != 0; }
+
+private:
+
+    /**
+    * Prevent copying
+    */
+    SleepRegions(const SleepRegions&) = delete;
+    SleepRegions& operator=(const SleepRegions&) = delete;
+
+    /**
+    * Sets whether the particles of a region are asleep
+    * @param particles The simulated state of all particles
+    * @param region The region to change
+    * @param sleep Whether the region is asleep
+    */
+    void SetAsleep(ParticleStore& particles, int region, bool sleep);
+
+    /**
+    * Finds the regions which are asleep along with all their neighbours
+    */
+    void UpdateSettled();
+
+    std::vector<int> m_particleRegion;      ///< Region for each particle
+    std::vector<int> m_regionStart;         ///< Start of each region's particles
+    std::vector<int> m_regionParticles;     ///< Particles sorted by region
+    std::vector<int> m_neighbourStart;      ///< Start of each region's neighbours
+    std::vector<int> m_neighbours;          ///< Regions connected to each region by a spring
+    std::vector<int> m_quietTicks;          ///< Ticks each region has not moved for
+    std::vector<float> m_motion;            ///< Furthest any particle of each region moved this tick
+    std::vector<unsigned char> m_asleep;    ///< Whether each region is asleep
+    std::vector<unsigned char> m_settled;   ///< Whether each region and its neighbours are asleep
+    int m_sleepingCount;                    ///< Number of regions asleep
+};
@@ -0,0 +1,119 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - spatialhash.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "spatialhash.h"
+#include <algorithm>
+#include <assert.h>
+
+namespace
+{
+    const unsigned int HASH_X = 73856093;  ///< Large prime to spread x cell coordinates
+    const unsigned int HASH_Y = 19349663;  ///< Large prime to spread y cell coordinates
+    const unsigned int HASH_Z = 83492791;  ///< Large prime to spread z cell coordinates
+    const int CELL_NEIGHBOURS = 27;        ///< Number of cells surrounding and including a cell
+}
+
+SpatialHash::SpatialHash() :
+    m_inverseCellSize(1.0f),
+    m_tableMask(0)
+{
+}
+
+void SpatialHash::Begin(int count, float cellSize)
+{
+    assert(cellSize > 0.0f);
+    m_inverseCellSize = 1.0f / cellSize;
+
+    // Table is a power of two at least double the particle
+    // count to keep the amount of shared buckets low
+    int tableSize = 1;
+    while(tableSize < count * 2)
+    {
+        tableSize <<= 1;
+    }
+    m_tableMask = static_cast<unsigned int>(tableSize - 1);
+
+    m_keys.resize(count);
+    m_sorted.resize(count);
+    m_bucketStart.assign(tableSize + 1, 0);
+    m_bucketFill.resize(tableSize);
+}
+
+void SpatialHash::Insert(int index, const D3DXVECTOR3& position)
+{
+    int x, y, z;
+    GetCell(position, x, y, z);
+    const int bucket = GetBucket(x, y, z);
+    m_keys[index] = bucket;
+    ++m_bucketStart[bucket + 1];
+}
+
+void SpatialHash::End()
+{
+    // Prefix sum the bucket counts into start offsets
+    for(unsigned int i = 1; i < m_bucketStart.size(); ++i)
+    {
+        m_bucketStart[i] += m_bucketStart[i-1];
+    }
+
+    // Scatter the particles into their buckets, keeping them in index order
+    std::copy(m_bucketStart.begin(), m_bucketStart.end()-1, m_bucketFill.begin());
+    for(unsigned int i = 0; i < m_keys.size(); ++i)
+    {
+        m_sorted[m_bucketFill[m_keys[i]]++] = static_cast<int>(i);
+    }
+}
+
+void SpatialHash::FindNeighbours(int index,
+                                 const D3DXVECTOR3& position,
+                                 std::vector<int>& neighbours,
+                                 bool allNeighbours) const
+{
+    neighbours.clear();
+
+    int x, y, z;
+    GetCell(position, x, y, z);
+
+    // Cells may hash to the same bucket; only visit each bucket once
+    int visited[CELL_NEIGHBOURS];
+    int visitedCount = 0;
+
+    for(int i = x-1; i <= x+1; ++i)
+    {
+        for(int j = y-1; j <= y+1; ++j)
+        {
+            for(int k = z-1; k <= z+1; ++k)
+            {
+                const int bucket = GetBucket(i, j, k);
+                if(std::find(visited, visited + visitedCount, bucket) != visited + visitedCount)
+                {
+                    continue;
+                }
+                visited[visitedCount++] = bucket;
+
+                for(int n = m_bucketStart[bucket]; n < m_bucketStart[bucket+1]; ++n)
+                {
+                    if(m_sorted[n] > index || (allNeighbours && m_sorted[n] != index))
+                    {
+                        neighbours.push_back(m_sorted[n]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void SpatialHash::GetCell(const D3DXVECTOR3& position, int& x, int& y, int& z) const
+{
+    x = static_cast<int>(floor(position.x * m_inverseCellSize));
+    y = static_cast<int>(floor(position.y * m_inverseCellSize));
+    z = static_cast<int>(floor(position.z * m_inverseCellSize));
+}
+
+int SpatialHash::GetBucket(int x, int y, int z) const
+{
+    const unsigned int hash = (static_cast<unsigned int>(x) * HASH_X) ^
+        (static_cast<unsigned int>(y) * HASH_Y) ^ (static_cast<unsigned int>(z) * HASH_Z);
+    return static_cast<int>(hash & m_tableMask);
+}
@@ -0,0 +1,70 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - spatialhash.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+
+/**
+* Uniform grid hashed into a fixed table for finding nearby particles
+* Rebuilt each tick through a counting sort of the particle cell keys
+*/
+class SpatialHash
+{
+public:
+
+    /**
+    * Constructor
+    */
+    SpatialHash();
+
+    /**
+    * Starts a rebuild of the hash grid
+    * @param count The number of particles that will be inserted
+    * @param cellSize The dimensions of a single grid cell
+    */
+    void Begin(int count, float cellSize);
+
+    /**
+    * Inserts a particle into the hash grid
+    * @param index The index of the particle
+    * @param position The position of the particle in world coordinates
+    */
+    void Insert(int index, const D3DXVECTOR3& position);
+
+    /**
+    * Finishes a rebuild of the hash grid and sorts the particles into cells
+    */
+    void End();
+
+    /**
+    * Fills the container with particles in the cells surrounding the position
+    * @param index The index of the particle querying; only higher indices are returned
+    * @param position The position to query around in world coordinates
+    * @param neighbours The container to fill with the particle indices
+    * @param allNeighbours Whether to return lower indices as well
+    */
+    void FindNeighbours(int index, const D3DXVECTOR3& position,
+        std::vector<int>& neighbours, bool allNeighbours = false) const;
+
+private:
+
+    /**
+    * @param position The position in world coordinates
+    * @param x/y/z The integer cell coordinates to fill in
+    */
+    void GetCell(const D3DXVECTOR3& position, int& x, int& y, int& z) const;
+
+    /**
+    * @param x/y/z The integer cell coordinates
+    * @return the table bucket for the cell
+    */
+    int GetBucket(int x, int y, int z) const;
+
+    float m_inverseCellSize;          ///< One over the dimensions of a cell
+    unsigned int m_tableMask;         ///< Mask to wrap a hash into the table
+    std::vector<int> m_keys;          ///< Bucket for each inserted particle
+    std::vector<int> m_bucketStart;   ///< Start of each bucket in the sorted particles
+    std::vector<int> m_bucketFill;    ///< Next free slot of each bucket while sorting
+    std::vector<int> m_sorted;        ///< Particle indices sorted by bucket
+};
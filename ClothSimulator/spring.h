@@ -5,11 +5,12 @@
 #pragma once
 #include "common.h"
 
-class Particle;
+class ParticleStore;
 class Diagnostic;
 
 /**
-* Spring between particles for the cloth
+* Type and diagnostic data for a spring between particles of the cloth
+* The data used to solve the spring is held in the packed springs
 */
 class Spring
 {
@@ -22,40 +23,33 @@ public:
     {
         STRETCH,
         SHEAR,
-        BEND
+        BEND,
+        MAX_TYPES
     };
 
     /**
     * Constructor
-    */
-    Spring();
-
-    /**
-    * Creates the spring
-    * @param p1/p2 The two particles connected by the spring
-    * @param id The ID of the particle
+    * @param id The ID of the spring
     * @param type The type of spring created
     */
-    void Initialise(Particle& p1, Particle& p2, int id, Type type);
+    Spring(int id, Type type);
 
     /**
-    * Update the spring
-    * @param timestep multiplier solved spring positions
+    * Updates the line diagnostic for the spring
+    * @param diagnostic The diagnostic renderer
+    * @param particles The simulated state of all particles
+    * @param index1/index2 The indices of the two particles connected by the spring
     */
-    void SolveSpring(float timestep);
+    void UpdateDiagnostic(Diagnostic& diagnostic, 
+        const ParticleStore& particles, int index1, int index2) const;
 
     /**
-    * Updates the line diagnostic for the spring
-    * @param diagnostic The diagnostic renderer
+    * @return the type of spring
     */
-    void UpdateDiagnostic(Diagnostic& diagnostic) const;
+    Type GetType() const { return m_type; }
 
 private:
 
-    Type m_type;            ///< type of spring
     int m_id;               ///< ID for the spring
-    int m_color;            ///< Color of spring depending on how it affects the cloth
-    Particle* m_particle1;  ///< connected particle
-    Particle* m_particle2;  ///< connected particle
-    float m_restDistance;   ///< distance for spring at rest
-};
+    Type m_type;            ///< type of spring
+};
\ No newline at end of file
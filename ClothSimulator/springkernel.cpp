@@ -0,0 +1,484 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - springkernel.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "springkernel.h"
+#include "particlestore.h"
+#include <intrin.h>
+
+namespace
+{
+    const int SSE_WIDTH = 4;   ///< Springs solved per SSE instruction
+    const int AVX_WIDTH = 8;   ///< Springs solved per AVX instruction
+
+    /**
+    * Compile time settings for solving springs of one type; settings
+    * known when compiling fold away instead of being read per spring
+    * @tparam Type The type of every spring solved
+    * @tparam Interacting Whether corrections are shared by the packed weights rather than equally
+    * @tparam Limiting Whether springs are only moved back within stretch limits
+    */
+    template<Spring::Type Type, bool Interacting, bool Limiting>
+    struct SpringPolicy
+    {
+        /**
+        * @return the fraction of the spring error corrected each iteration
+        */
+        static constexpr float Correction()
+        {
+            return Limiting ? 1.0f : GetSpringCorrection(Type);
+        }
+
+        /**
+        * @return whether springs are only moved back within stretch limits
+        */
+        static constexpr bool IsLimiting()
+        {
+            return Limiting;
+        }
+
+        /**
+        * @return whether the packed weights are read for each spring
+        */
+        static constexpr bool IsInteracting()
+        {
+            return Interacting;
+        }
+    };
+
+    /**
+    * Approximate reciprocal square root refined with one Newton-Raphson step
+    * @note matches the vector paths lane for lane so all paths give the same result
+    * @param value The value to get the reciprocal square root of
+    * @return the reciprocal square root
+    */
+    inline float ReciprocalSqrt(float value)
+    {
+        float estimate = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(value)));
+        return estimate * (1.5f - ((0.5f * value) * estimate) * estimate);
+    }
+
+    /**
+    * @return whether the processor and operating system support AVX2
+    */
+    bool IsAVX2Supported()
+    {
+        int info[4];
+        __cpuid(info, 0);
+        if(info[0] < 7)
+        {
+            return false;
+        }
+
+        // Operating system must save the ymm registers on a context switch
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        if(!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+        {
+            return false;
+        }
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }
+
+    /**
+    * @return whether the processor supports SSE4.1
+    */
+    bool IsSSE4Supported()
+    {
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 19)) != 0;
+    }
+}
+
+SpringKernel::SpringKernel() :
+    m_path(SCALAR)
+{
+    m_supported[SCALAR] = true;
+    m_supported[SSE4] = IsSSE4Supported();
+    m_supported[AVX2] = m_supported[SSE4] && IsAVX2Supported();
+    m_path = m_supported[AVX2] ? AVX2 : (m_supported[SSE4] ? SSE4 : SCALAR);
+}
+
+bool SpringKernel::IsSupported(Path path) const
+{
+    return m_supported[path];
+}
+
+void SpringKernel::SetPath(Path path)
+{
+    if(IsSupported(path))
+    {
+        m_path = path;
+    }
+}
+
+std::string SpringKernel::GetPathName(Path path)
+{
+    switch(path)
+    {
+    case SCALAR:
+        return "Scalar";
+    case SSE4:
+        return "SSE4";
+    case AVX2:
+        return "AVX2";
+    default:
+        return "None";
+    }
+}
+
+template<Spring::Type Type, bool Interacting>
+void SpringKernel::Solve(const PackedSprings& springs,
+                         ParticleStore& particles,
+                         int begin,
+                         int end) const
+{
+    SolvePath<SpringPolicy<Type, Interacting, false>>(
+        springs, particles, 1.0f, 1.0f, begin, end);
+}
+
+template<Spring::Type Type, bool Interacting>
+void SpringKernel::Limit(const PackedSprings& springs,
+                         ParticleStore& particles,
+                         float minStretch,
+                         float maxStretch,
+                         int begin,
+                         int end) const
+{
+    SolvePath<SpringPolicy<Type, Interacting, true>>(
+        springs, particles, minStretch, maxStretch, begin, end);
+}
+
+template<typename Policy>
+void SpringKernel::SolvePath(const PackedSprings& springs,
+                             ParticleStore& particles,
+                             float minStretch,
+                             float maxStretch,
+                             int begin,
+                             int end) const
+{
+    if(begin >= end)
+    {
+        return;
+    }
+
+    float* positions = particles.GetPositionComponents();
+    const float* inverseMass = particles.GetInverseMasses();
+
+    switch(m_path)
+    {
+    case AVX2:
+        SolveAVX2<Policy>(springs, positions, inverseMass, minStretch, maxStretch, begin, end);
+        break;
+    case SSE4:
+        SolveSSE4<Policy>(springs, positions, inverseMass, minStretch, maxStretch, begin, end);
+        break;
+    default:
+        SolveScalar<Policy>(springs, positions, inverseMass, minStretch, maxStretch, begin, end);
+        break;
+    }
+}
+
+template<Spring::Type Type, bool Interacting>
+void SpringKernel::SolveCompliant(const PackedSprings& springs,
+                                  ParticleStore& particles,
+                                  float* lambda,
+                                  float compliance,
+                                  float timestepSqr,
+                                  int begin,
+                                  int end) const
+{
+    const float alpha = compliance / timestepSqr;
+    for(int i = begin; i < end; ++i)
+    {
+        const int index1 = springs.index1[i];
+        const int index2 = springs.index2[i];
+        const D3DXVECTOR3 difference = particles.GetPosition(index2) - particles.GetPosition(index1);
+        const float distance = D3DXVec3Length(&difference);
+
+        // Interacting velocity weights share the particle mass between the pair
+        const float weight = Interacting ? springs.weight[i] : 0.5f;
+        const float w1 = particles.GetInverseMass(index1) * weight;
+        const float w2 = particles.GetInverseMass(index2) * (1.0f - weight);
+        const float denominator = w1 + w2 + alpha;
+
+        if(distance == 0.0f || denominator == 0.0f)
+        {
+            continue;
+        }
+
+        // Constraint is the stretch from rest; compliance limits the 
+        // correction by the multiplier already applied this step
+        const float constraint = distance - springs.rest[i];
+        const float deltaLambda = (-constraint - (alpha * lambda[i])) / denominator;
+        lambda[i] += deltaLambda;
+
+        const D3DXVECTOR3 correction = difference * (deltaLambda / distance);
+        particles.MovePosition(index1, -correction * w1);
+        particles.MovePosition(index2, correction * w2);
+    }
+}
+
+template<typename Policy>
+void SpringKernel::SolveScalar(const PackedSprings& springs,
+                               float* positions,
+                               const float* inverseMass,
+                               float minStretch,
+                               float maxStretch,
+                               int begin,
+                               int end)
+{
+    for(int i = begin; i < end; ++i)
+    {
+        const int index1 = springs.index1[i];
+        const int index2 = springs.index2[i];
+        float* p1 = positions + (index1 * 3);
+        float* p2 = positions + (index2 * 3);
+
+        const float dx = p2[0] - p1[0];
+        const float dy = p2[1] - p1[1];
+        const float dz = p2[2] - p1[2];
+        const float lengthSqr = ((dx * dx) + (dy * dy)) + (dz * dz);
+
+        // Error is the difference minus the normalized difference scaled by the rest.
+        // Limiting clamps the length to the limits so springs within them have no error
+        float ratio = springs.rest[i] * ReciprocalSqrt(lengthSqr);
+        if(Policy::IsLimiting())
+        {
+            ratio = max(minStretch * ratio, min(1.0f, maxStretch * ratio));
+        }
+        const float scale = (1.0f - ratio) * Policy::Correction();
+        const float ex = dx * scale;
+        const float ey = dy * scale;
+        const float ez = dz * scale;
+
+        // Pinned particles have no inverse mass and do not move
+        const float weight = Policy::IsInteracting() ? springs.weight[i] : 0.5f;
+        const float w1 = inverseMass[index1] != 0.0f ? weight : 0.0f;
+        const float w2 = inverseMass[index2] != 0.0f ? 1.0f - weight : 0.0f;
+
+        p1[0] += ex * w1;
+        p1[1] += ey * w1;
+        p1[2] += ez * w1;
+        p2[0] -= ex * w2;
+        p2[1] -= ey * w2;
+        p2[2] -= ez * w2;
+    }
+}
+
+template<typename Policy>
+void SpringKernel::SolveSSE4(const PackedSprings& springs,
+                             float* positions,
+                             const float* inverseMass,
+                             float minStretch,
+                             float maxStretch,
+                             int begin,
+                             int end)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+    const __m128 correction = _mm_set1_ps(Policy::Correction());
+    const __m128 minimum = _mm_set1_ps(minStretch);
+    const __m128 maximum = _mm_set1_ps(maxStretch);
+    const __m128i three = _mm_set1_epi32(3);
+
+    alignas(16) int offset1[SSE_WIDTH];
+    alignas(16) int offset2[SSE_WIDTH];
+    alignas(16) float result[6][SSE_WIDTH];
+
+    int i = begin;
+    for(; i + SSE_WIDTH <= end; i += SSE_WIDTH)
+    {
+        const __m128i index1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&springs.index1[i]));
+        const __m128i index2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&springs.index2[i]));
+        _mm_store_si128(reinterpret_cast<__m128i*>(offset1), _mm_mullo_epi32(index1, three));
+        _mm_store_si128(reinterpret_cast<__m128i*>(offset2), _mm_mullo_epi32(index2, three));
+
+        // SSE has no gather; load the particle components one lane at a time
+        #define GATHER(base, offset, component) _mm_set_ps(base[offset[3] + component], \
+            base[offset[2] + component], base[offset[1] + component], base[offset[0] + component])
+
+        const __m128 x1 = GATHER(positions, offset1, 0);
+        const __m128 y1 = GATHER(positions, offset1, 1);
+        const __m128 z1 = GATHER(positions, offset1, 2);
+        const __m128 x2 = GATHER(positions, offset2, 0);
+        const __m128 y2 = GATHER(positions, offset2, 1);
+        const __m128 z2 = GATHER(positions, offset2, 2);
+
+        #undef GATHER
+
+        const __m128 mass1 = _mm_set_ps(inverseMass[springs.index1[i+3]], inverseMass[springs.index1[i+2]],
+            inverseMass[springs.index1[i+1]], inverseMass[springs.index1[i]]);
+        const __m128 mass2 = _mm_set_ps(inverseMass[springs.index2[i+3]], inverseMass[springs.index2[i+2]],
+            inverseMass[springs.index2[i+1]], inverseMass[springs.index2[i]]);
+
+        const __m128 dx = _mm_sub_ps(x2, x1);
+        const __m128 dy = _mm_sub_ps(y2, y1);
+        const __m128 dz = _mm_sub_ps(z2, z1);
+        const __m128 lengthSqr = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+        __m128 inverseLength = _mm_rsqrt_ps(lengthSqr);
+        inverseLength = _mm_mul_ps(inverseLength, _mm_sub_ps(threeHalves, _mm_mul_ps(
+            _mm_mul_ps(_mm_mul_ps(half, lengthSqr), inverseLength), inverseLength)));
+
+        const __m128 rest = _mm_loadu_ps(&springs.rest[i]);
+        __m128 ratio = _mm_mul_ps(rest, inverseLength);
+        if(Policy::IsLimiting())
+        {
+            ratio = _mm_max_ps(_mm_mul_ps(minimum, ratio), _mm_min_ps(one, _mm_mul_ps(maximum, ratio)));
+        }
+
+        __m128 scale = _mm_sub_ps(one, ratio);
+        if(Policy::Correction() != 1.0f)
+        {
+            scale = _mm_mul_ps(scale, correction);
+        }
+        const __m128 ex = _mm_mul_ps(dx, scale);
+        const __m128 ey = _mm_mul_ps(dy, scale);
+        const __m128 ez = _mm_mul_ps(dz, scale);
+
+        const __m128 weight = Policy::IsInteracting() ? _mm_loadu_ps(&springs.weight[i]) : half;
+        const __m128 w1 = _mm_and_ps(weight, _mm_cmpneq_ps(mass1, zero));
+        const __m128 w2 = _mm_and_ps(_mm_sub_ps(one, weight), _mm_cmpneq_ps(mass2, zero));
+
+        _mm_store_ps(result[0], _mm_add_ps(x1, _mm_mul_ps(ex, w1)));
+        _mm_store_ps(result[1], _mm_add_ps(y1, _mm_mul_ps(ey, w1)));
+        _mm_store_ps(result[2], _mm_add_ps(z1, _mm_mul_ps(ez, w1)));
+        _mm_store_ps(result[3], _mm_sub_ps(x2, _mm_mul_ps(ex, w2)));
+        _mm_store_ps(result[4], _mm_sub_ps(y2, _mm_mul_ps(ey, w2)));
+        _mm_store_ps(result[5], _mm_sub_ps(z2, _mm_mul_ps(ez, w2)));
+
+        // Springs in the range share no particles so the lanes never overlap
+        for(int lane = 0; lane < SSE_WIDTH; ++lane)
+        {
+            positions[offset1[lane]] = result[0][lane];
+            positions[offset1[lane] + 1] = result[1][lane];
+            positions[offset1[lane] + 2] = result[2][lane];
+            positions[offset2[lane]] = result[3][lane];
+            positions[offset2[lane] + 1] = result[4][lane];
+            positions[offset2[lane] + 2] = result[5][lane];
+        }
+    }
+
+    SolveScalar<Policy>(springs, positions, inverseMass, minStretch, maxStretch, i, end);
+}
+
+template<typename Policy>
+void SpringKernel::SolveAVX2(const PackedSprings& springs,
+                             float* positions,
+                             const float* inverseMass,
+                             float minStretch,
+                             float maxStretch,
+                             int begin,
+                             int end)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    const __m256 correction = _mm256_set1_ps(Policy::Correction());
+    const __m256 minimum = _mm256_set1_ps(minStretch);
+    const __m256 maximum = _mm256_set1_ps(maxStretch);
+    const __m256i three = _mm256_set1_epi32(3);
+
+    alignas(32) int offset1[AVX_WIDTH];
+    alignas(32) int offset2[AVX_WIDTH];
+    alignas(32) float result[6][AVX_WIDTH];
+
+    int i = begin;
+    for(; i + AVX_WIDTH <= end; i += AVX_WIDTH)
+    {
+        const __m256i index1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&springs.index1[i]));
+        const __m256i index2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&springs.index2[i]));
+        const __m256i component1 = _mm256_mullo_epi32(index1, three);
+        const __m256i component2 = _mm256_mullo_epi32(index2, three);
+
+        const __m256 x1 = _mm256_i32gather_ps(positions, component1, 4);
+        const __m256 y1 = _mm256_i32gather_ps(positions + 1, component1, 4);
+        const __m256 z1 = _mm256_i32gather_ps(positions + 2, component1, 4);
+        const __m256 x2 = _mm256_i32gather_ps(positions, component2, 4);
+        const __m256 y2 = _mm256_i32gather_ps(positions + 1, component2, 4);
+        const __m256 z2 = _mm256_i32gather_ps(positions + 2, component2, 4);
+        const __m256 mass1 = _mm256_i32gather_ps(inverseMass, index1, 4);
+        const __m256 mass2 = _mm256_i32gather_ps(inverseMass, index2, 4);
+
+        const __m256 dx = _mm256_sub_ps(x2, x1);
+        const __m256 dy = _mm256_sub_ps(y2, y1);
+        const __m256 dz = _mm256_sub_ps(z2, z1);
+        const __m256 lengthSqr = _mm256_add_ps(_mm256_add_ps(
+            _mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+
+        __m256 inverseLength = _mm256_rsqrt_ps(lengthSqr);
+        inverseLength = _mm256_mul_ps(inverseLength, _mm256_sub_ps(threeHalves, _mm256_mul_ps(
+            _mm256_mul_ps(_mm256_mul_ps(half, lengthSqr), inverseLength), inverseLength)));
+
+        const __m256 rest = _mm256_loadu_ps(&springs.rest[i]);
+        __m256 ratio = _mm256_mul_ps(rest, inverseLength);
+        if(Policy::IsLimiting())
+        {
+            ratio = _mm256_max_ps(_mm256_mul_ps(minimum, ratio), _mm256_min_ps(one, _mm256_mul_ps(maximum, ratio)));
+        }
+
+        __m256 scale = _mm256_sub_ps(one, ratio);
+        if(Policy::Correction() != 1.0f)
+        {
+            scale = _mm256_mul_ps(scale, correction);
+        }
+        const __m256 ex = _mm256_mul_ps(dx, scale);
+        const __m256 ey = _mm256_mul_ps(dy, scale);
+        const __m256 ez = _mm256_mul_ps(dz, scale);
+
+        const __m256 weight = Policy::IsInteracting() ? _mm256_loadu_ps(&springs.weight[i]) : half;
+        const __m256 w1 = _mm256_and_ps(weight, _mm256_cmp_ps(mass1, zero, _CMP_NEQ_UQ));
+        const __m256 w2 = _mm256_and_ps(_mm256_sub_ps(one, weight), _mm256_cmp_ps(mass2, zero, _CMP_NEQ_UQ));
+
+        _mm256_store_ps(result[0], _mm256_add_ps(x1, _mm256_mul_ps(ex, w1)));
+        _mm256_store_ps(result[1], _mm256_add_ps(y1, _mm256_mul_ps(ey, w1)));
+        _mm256_store_ps(result[2], _mm256_add_ps(z1, _mm256_mul_ps(ez, w1)));
+        _mm256_store_ps(result[3], _mm256_sub_ps(x2, _mm256_mul_ps(ex, w2)));
+        _mm256_store_ps(result[4], _mm256_sub_ps(y2, _mm256_mul_ps(ey, w2)));
+        _mm256_store_ps(result[5], _mm256_sub_ps(z2, _mm256_mul_ps(ez, w2)));
+        _mm256_store_si256(reinterpret_cast<__m256i*>(offset1), component1);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(offset2), component2);
+
+        // AVX2 has no scatter; springs in the range share no particles so the lanes never overlap
+        for(int lane = 0; lane < AVX_WIDTH; ++lane)
+        {
+            positions[offset1[lane]] = result[0][lane];
+            positions[offset1[lane] + 1] = result[1][lane];
+            positions[offset1[lane] + 2] = result[2][lane];
+            positions[offset2[lane]] = result[3][lane];
+            positions[offset2[lane] + 1] = result[4][lane];
+            positions[offset2[lane] + 2] = result[5][lane];
+        }
+    }
+
+    // Avoid the penalty of mixing AVX and SSE encodings in the remainder
+    _mm256_zeroupper();
+    SolveScalar<Policy>(springs, positions, inverseMass, minStretch, maxStretch, i, end);
+}
+
+// Cloth solves and limits each spring type with and without interacting weights
+#define INSTANTIATE_SPRING_KERNELS(type, interacting) \
+    template void SpringKernel::Solve<type, interacting>( \
+        const PackedSprings&, ParticleStore&, int, int) const; \
+    template void SpringKernel::Limit<type, interacting>( \
+        const PackedSprings&, ParticleStore&, float, float, int, int) const; \
+    template void SpringKernel::SolveCompliant<type, interacting>( \
+        const PackedSprings&, ParticleStore&, float*, float, float, int, int) const;
+
+INSTANTIATE_SPRING_KERNELS(Spring::STRETCH, false)
+INSTANTIATE_SPRING_KERNELS(Spring::STRETCH, true)
+INSTANTIATE_SPRING_KERNELS(Spring::SHEAR, false)
+INSTANTIATE_SPRING_KERNELS(Spring::SHEAR, true)
+INSTANTIATE_SPRING_KERNELS(Spring::BEND, false)
+INSTANTIATE_SPRING_KERNELS(Spring::BEND, true)
+
+#undef INSTANTIATE_SPRING_KERNELS
\ No newline at end of file
@@ -0,0 +1,204 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - springkernel.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+#include "alignedallocator.h"
+#include "spring.h"
+
+class ParticleStore;
+
+typedef std::vector<int, AlignedAllocator<int>> IndexArray;
+typedef std::vector<float, AlignedAllocator<float>> FloatArray;
+
+static constexpr float STRETCH_CORRECTION = 1.0f;  ///< Fraction of the stretch spring error corrected per iteration
+static constexpr float SHEAR_CORRECTION = 0.75f;   ///< Fraction of the shear spring error corrected per iteration
+static constexpr float BEND_CORRECTION = 0.5f;     ///< Fraction of the bend spring error corrected per iteration
+
+/**
+* Stretch is corrected fully to keep the cloth from growing while shear and
+* bend are corrected less so the cloth folds and drapes more easily
+* @param type The type of spring
+* @return the fraction of the spring error corrected each iteration by the position solvers
+*/
+constexpr float GetSpringCorrection(Spring::Type type)
+{
+    return type == Spring::STRETCH ? STRETCH_CORRECTION :
+        (type == Spring::SHEAR ? SHEAR_CORRECTION : BEND_CORRECTION);
+}
+
+/**
+* Packed data for all springs read by the spring kernel
+*/
+struct PackedSprings
+{
+    IndexArray index1;    ///< Index of the first particle for each spring
+    IndexArray index2;    ///< Index of the second particle for each spring
+    FloatArray rest;      ///< Distance for each spring at rest
+    FloatArray inverseRest; ///< Inverse of the distance for each spring at rest
+    FloatArray weight;    ///< Fraction of the correction that moves the first particle
+    IndexArray typeStart; ///< Start of each run of one type; runs cycle through the types for each batch
+};
+
+/**
+* Moves the particle with the smallest amount of interacting 
+* velocity towards the particle with the most amount
+* @param velocity1/velocity2 The interacting velocity of each particle of a spring
+* @return the fraction of the correction that moves the first particle
+*/
+inline float GetInteractingWeight(const D3DXVECTOR3& velocity1, const D3DXVECTOR3& velocity2)
+{
+    if(velocity1 != velocity2 && (!IsZeroVector(velocity1) || !IsZeroVector(velocity2)))
+    {
+        return D3DXVec3LengthSq(&velocity1) > D3DXVec3LengthSq(&velocity2) ? 0.1f : 0.9f;
+    }
+    return 0.5f;
+}
+
+/**
+* Solves ranges of springs from packed arrays using the widest
+* vector instructions supported by the processor
+*/
+class SpringKernel
+{
+public:
+
+    /**
+    * Instruction sets the kernel can be run with
+    */
+    enum Path
+    {
+        SCALAR,
+        SSE4,
+        AVX2,
+        MAX_PATHS
+    };
+
+    /**
+    * Constructor; selects the fastest path supported by the processor
+    */
+    SpringKernel();
+
+    /**
+    * @param path The path to query
+    * @return whether the processor supports the path
+    */
+    bool IsSupported(Path path) const;
+
+    /**
+    * @param path The path to use if supported
+    */
+    void SetPath(Path path);
+
+    /**
+    * @return the path currently used
+    */
+    Path GetPath() const { return m_path; }
+
+    /**
+    * @param path The path to get the name for
+    * @return the name of the path
+    */
+    static std::string GetPathName(Path path);
+
+    /**
+    * Solves a range of springs of one type
+    * @note no two springs in the range may share a particle
+    * @tparam Type The type of every spring in the range
+    * @tparam Interacting Whether corrections are shared by the packed weights rather than equally
+    * @param springs The packed data for all springs
+    * @param particles The simulated state of all particles
+    * @param begin/end The range of springs to solve
+    */
+    template<Spring::Type Type, bool Interacting>
+    void Solve(const PackedSprings& springs, ParticleStore& particles, int begin, int end) const;
+
+    /**
+    * Limits the stretch of a range of springs of one type; springs within
+    * the limits are left alone and others are moved onto the nearest limit
+    * @note no two springs in the range may share a particle
+    * @tparam Type The type of every spring in the range
+    * @tparam Interacting Whether corrections are shared by the packed weights rather than equally
+    * @param springs The packed data for all springs
+    * @param particles The simulated state of all particles
+    * @param minStretch/maxStretch The smallest and largest length of each spring as a ratio of its rest
+    * @param begin/end The range of springs to limit
+    */
+    template<Spring::Type Type, bool Interacting>
+    void Limit(const PackedSprings& springs, ParticleStore& particles,
+        float minStretch, float maxStretch, int begin, int end) const;
+
+    /**
+    * Solves a range of springs of one type as compliant constraints using 
+    * extended position based dynamics
+    * @note no two springs in the range may share a particle
+    * @tparam Type The type of every spring in the range
+    * @tparam Interacting Whether corrections are shared by the packed weights rather than equally
+    * @param springs The packed data for all springs
+    * @param particles The simulated state of all particles
+    * @param lambda The Lagrange multiplier accumulated for each spring this step
+    * @param compliance The inverse stiffness of the type of spring
+    * @param timestepSqr The step time squared used to scale the compliance
+    * @param begin/end The range of springs to solve
+    */
+    template<Spring::Type Type, bool Interacting>
+    void SolveCompliant(const PackedSprings& springs, ParticleStore& particles, 
+        float* lambda, float compliance, float timestepSqr, int begin, int end) const;
+
+private:
+
+    /**
+    * Solves a range of springs with the path currently used
+    * @tparam Policy The compile time settings for the type of spring
+    * @param springs The packed data for all springs
+    * @param particles The simulated state of all particles
+    * @param minStretch/maxStretch The stretch limits when the policy is limiting
+    * @param begin/end The range of springs to solve
+    */
+    template<typename Policy>
+    void SolvePath(const PackedSprings& springs, ParticleStore& particles,
+        float minStretch, float maxStretch, int begin, int end) const;
+
+    /**
+    * Solves a range of springs one at a time
+    * @tparam Policy The compile time settings for the type of spring
+    * @param springs The packed data for all springs
+    * @param positions The x, y, z components of all particle positions
+    * @param inverseMass The inverse mass of all particles
+    * @param minStretch/maxStretch The stretch limits when the policy is limiting
+    * @param begin/end The range of springs to solve
+    */
+    template<typename Policy>
+    static void SolveScalar(const PackedSprings& springs, float* positions,
+        const float* inverseMass, float minStretch, float maxStretch, int begin, int end);
+
+    /**
+    * Solves a range of springs four at a time
+    * @tparam Policy The compile time settings for the type of spring
+    * @param springs The packed data for all springs
+    * @param positions The x, y, z components of all particle positions
+    * @param inverseMass The inverse mass of all particles
+    * @param minStretch/maxStretch The stretch limits when the policy is limiting
+    * @param begin/end The range of springs to solve
+    */
+    template<typename Policy>
+    static void SolveSSE4(const PackedSprings& springs, float* positions,
+        const float* inverseMass, float minStretch, float maxStretch, int begin, int end);
+
+    /**
+    * Solves a range of springs eight at a time
+    * @tparam Policy The compile time settings for the type of spring
+    * @param springs The packed data for all springs
+    * @param positions The x, y, z components of all particle positions
+    * @param inverseMass The inverse mass of all particles
+    * @param minStretch/maxStretch The stretch limits when the policy is limiting
+    * @param begin/end The range of springs to solve
+    */
+    template<typename Policy>
+    static void SolveAVX2(const PackedSprings& springs, float* positions,
+        const float* inverseMass, float minStretch, float maxStretch, int begin, int end);
+
+    Path m_path;                    ///< Path currently used to solve
+    bool m_supported[MAX_PATHS];    ///< Whether each path is supported
+};
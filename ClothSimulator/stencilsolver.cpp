@@ -0,0 +1,177 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - stencilsolver.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "stencilsolver.h"
+#include "particlestore.h"
+#include "springkernel.h"
+#include "threadpool.h"
+#include "gridlayout.h"
+
+namespace
+{
+    const int MIN_PARALLEL_PARTICLES = 1024;  ///< Smallest grid worth splitting across threads
+    const float DIAGONAL_LENGTH = 1.41421356f; ///< Rest distance of a shear spring in spacings
+    const float BEND_LENGTH = 2.0f;            ///< Rest distance of a bend spring in spacings
+
+    /**
+    * Solves a single spring between two particles
+    * @tparam Interacting Whether to share the correction by the interacting velocity
+    * @param particles The simulated state of all particles
+    * @param positions The x, y, z components of all particle positions
+    * @param inverseMass The inverse mass of all particles
+    * @param index1/index2 The indices of the two particles connected by the spring
+    * @param rest The rest distance of the spring
+    * @param correction The fraction of the spring error to correct
+    */
+    template<bool Interacting>
+    inline void SolveSpring(const ParticleStore& particles,
+                            float* positions,
+                            const float* inverseMass,
+                            int index1,
+                            int index2,
+                            float rest,
+                            float correction)
+    {
+        float* p1 = positions + (index1 * 3);
+        float* p2 = positions + (index2 * 3);
+
+        const float dx = p2[0] - p1[0];
+        const float dy = p2[1] - p1[1];
+        const float dz = p2[2] - p1[2];
+        const float lengthSqr = ((dx * dx) + (dy * dy)) + (dz * dz);
+        if(lengthSqr == 0.0f)
+        {
+            return;
+        }
+
+        // Error is the difference minus the normalized difference scaled by the rest
+        const float scale = (1.0f - (rest / std::sqrt(lengthSqr))) * correction;
+        const float ex = dx * scale;
+        const float ey = dy * scale;
+        const float ez = dz * scale;
+
+        const float weight = Interacting ? GetInteractingWeight(
+            particles.GetInteractingVelocity(index1),
+            particles.GetInteractingVelocity(index2)) : 0.5f;
+
+        // Pinned particles have no inverse mass and do not move
+        const float w1 = inverseMass[index1] != 0.0f ? weight : 0.0f;
+        const float w2 = inverseMass[index2] != 0.0f ? 1.0f - weight : 0.0f;
+
+        p1[0] += ex * w1;
+        p1[1] += ey * w1;
+        p1[2] += ez * w1;
+        p2[0] -= ex * w2;
+        p2[1] -= ey * w2;
+        p2[2] -= ez * w2;
+    }
+}
+
+StencilSolver::StencilSolver(ThreadPool& threads) :
+    m_threads(threads)
+{
+}
+
+void StencilSolver::Solve(ParticleStore& particles, 
+                          const GridLayout& layout, 
+                          float spacing, 
+                          bool interacting, 
+                          bool bend)
+{
+    if(bend && interacting)
+    {
+        SolveStencils<true, true>(particles, layout, spacing);
+    }
+    else if(bend)
+    {
+        SolveStencils<true, false>(particles, layout, spacing);
+    }
+    else if(interacting)
+    {
+        SolveStencils<false, true>(particles, layout, spacing);
+    }
+    else
+    {
+        SolveStencils<false, false>(particles, layout, spacing);
+    }
+}
+
+template<bool Bend, bool Interacting>
+void StencilSolver::SolveStencils(ParticleStore& particles, const GridLayout& layout, float spacing)
+{
+    /* Offsets of the springs from their first particle
+    ------ column
+    |  |  |    Stretch: (1,0) (0,1)
+    -------    Shear: (1,1) (1,-1)
+    |  |  |    Bending: (2,0) (0,2)
+    ------
+    row */
+
+    SolveStencil<1, 0, Interacting>(particles, layout, spacing);
+    SolveStencil<0, 1, Interacting>(particles, layout, spacing);
+    SolveStencil<1, 1, Interacting>(particles, layout, spacing * DIAGONAL_LENGTH);
+    SolveStencil<1, -1, Interacting>(particles, layout, spacing * DIAGONAL_LENGTH);
+    if(Bend)
+    {
+        SolveStencil<2, 0, Interacting>(particles, layout, spacing * BEND_LENGTH);
+        SolveStencil<0, 2, Interacting>(particles, layout, spacing * BEND_LENGTH);
+    }
+}
+
+template<int Column, int Row, bool Interacting>
+void StencilSolver::SolveStencil(ParticleStore& particles, const GridLayout& layout, float rest)
+{
+    static_assert(Column > 0 || (Column == 0 && Row > 0),
+        "Stencils must point to a later column or a later row of the same column");
+
+    // Springs starting a stencil length apart share a particle so blocks of that
+    // length alternate between two phases; each phase has no shared particles.
+    // Offsets across columns alternate blocks of columns, otherwise blocks of rows.
+    // Phases are chosen by grid cell so they hold for any particle layout
+    const int rows = layout.GetRows();
+    const int columnEnd = rows - Column;
+    const int rowBegin = max(0, -Row);
+    const int rowEnd = min(rows, rows - Row);
+    const int rowBlock = Column > 0 ? rows : Row;
+    const Spring::Type type = Column != 0 && Row != 0 ? Spring::SHEAR :
+        (Column + Row > 1 ? Spring::BEND : Spring::STRETCH);
+    const float correction = GetSpringCorrection(type);
+    float* positions = particles.GetPositionComponents();
+    const float* inverseMass = particles.GetInverseMasses();
+
+    for(int phase = 0; phase < 2; ++phase)
+    {
+        const std::function<void(int, int)> solveColumns = [&](int begin, int end)
+        {
+            for(int column = begin; column < end; ++column)
+            {
+                if(Column > 0 && (column / Column) % 2 != phase)
+                {
+                    continue;
+                }
+
+                const int blockBegin = Column > 0 ? rowBegin : rowBegin + (phase * Row);
+                for(int block = blockBegin; block < rowEnd; block += rowBlock * 2)
+                {
+                    const int blockEnd = min(block + rowBlock, rowEnd);
+                    for(int row = block; row < blockEnd; ++row)
+                    {
+                        SolveSpring<Interacting>(particles, positions, inverseMass,
+                            layout.GetParticle(column, row),
+                            layout.GetParticle(column + Column, row + Row), rest, correction);
+                    }
+                }
+            }
+        };
+
+        if(rows * rows < MIN_PARALLEL_PARTICLES)
+        {
+            solveColumns(0, columnEnd);
+        }
+        else
+        {
+            m_threads.ParallelFor(columnEnd, solveColumns);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - stencilsolver.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "common.h"
+
+class ParticleStore;
+class ThreadPool;
+class GridLayout;
+
+/**
+* Solves the springs of a regular particle grid without any per-spring data
+* Each spring is found from its first particle by a fixed offset and its rest
+* distance from the grid spacing, so only the particles are read and written
+*/
+class StencilSolver
+{
+public:
+
+    /**
+    * Constructor
+    * @param threads The threads to split the solve between
+    */
+    explicit StencilSolver(ThreadPool& threads);
+
+    /**
+    * Solves one Gauss-Seidel iteration of all grid springs
+    * @param particles The simulated state of all particles
+    * @param layout The grid the particles are stored in
+    * @param spacing The rest distance between neighbouring particles
+    * @param interacting Whether any particle is interacting with a moving mesh
+    * @param bend Whether the bend springs are solved
+    */
+    void Solve(ParticleStore& particles, const GridLayout& layout, 
+        float spacing, bool interacting, bool bend);
+
+private:
+
+    /**
+    * Prevent copying
+    */
+    StencilSolver(const StencilSolver&) = delete;
+    StencilSolver& operator=(const StencilSolver&) = delete;
+
+    /**
+    * Solves all springs of the grid with the same offset
+    * @tparam Column/Row The offset from the first to the second particle of each spring
+    * @tparam Interacting Whether to share corrections by the interacting velocity
+    * @param particles The simulated state of all particles
+    * @param layout The grid the particles are stored in
+    * @param rest The rest distance of the springs
+    */
+    template<int Column, int Row, bool Interacting>
+    void SolveStencil(ParticleStore& particles, const GridLayout& layout, float rest);
+
+    /**
+    * Solves every grid spring offset in turn
+    * @tparam Bend Whether the bend springs are solved or compiled out
+    * @tparam Interacting Whether to share corrections by the interacting velocity
+    * @param particles The simulated state of all particles
+    * @param layout The grid the particles are stored in
+    * @param spacing The rest distance between neighbouring particles
+    */
+    template<bool Bend, bool Interacting>
+    void SolveStencils(ParticleStore& particles, const GridLayout& layout, float spacing);
+
+    ThreadPool& m_threads; ///< Threads to split the solve between
+};
@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - threadpool.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "threadpool.h"
+
+ThreadPool::ThreadPool(int workers) :
+    m_work(nullptr),
+    m_count(0),
+    m_pending(0),
+    m_generation(0),
+    m_exit(false)
+{
+    for(int i = 0; i < workers; ++i)
+    {
+        // The calling thread always runs chunk zero
+        m_workers.push_back(std::thread(&ThreadPool::WorkerLoop, this, i+1));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exit = true;
+    }
+    m_start.notify_all();
+
+    for(std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+int ThreadPool::GetThreadCount() const
+{
+    return static_cast<int>(m_workers.size()) + 1;
+}
+
+void ThreadPool::ParallelFor(int count, const RangeFn& work)
+{
+    if(m_workers.empty() || count < GetThreadCount())
+    {
+        work(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_work = &work;
+        m_count = count;
+        m_pending = static_cast<int>(m_workers.size());
+        ++m_generation;
+    }
+    m_start.notify_all();
+
+    RunChunk(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this](){ return m_pending == 0; });
+    m_work = nullptr;
+}
+
+void ThreadPool::RunChunk(int thread)
+{
+    const int threads = GetThreadCount();
+    const int begin = (m_count * thread) / threads;
+    const int end = (m_count * (thread + 1)) / threads;
+    if(begin < end)
+    {
+        (*m_work)(begin, end);
+    }
+}
+
+void ThreadPool::WorkerLoop(int thread)
+{
+    int generation = 0;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [this, generation]()
+                { return m_exit || m_generation != generation; });
+
+            if(m_exit)
+            {
+                return;
+            }
+            generation = m_generation;
+        }
+
+        RunChunk(thread);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(--m_pending == 0)
+        {
+            m_done.notify_one();
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - threadpool.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include <functional>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/**
+* Fixed set of worker threads that split a range of work with the calling thread
+*/
+class ThreadPool
+{
+public:
+
+    typedef std::function<void(int, int)> RangeFn;
+
+    /**
+    * Constructor; starts the worker threads
+    * @param workers The amount of threads to create in addition to the caller
+    */
+    explicit ThreadPool(int workers);
+
+    /**
+    * Destructor; waits for the worker threads to finish
+    */
+    ~ThreadPool();
+
+    /**
+    * Splits the range into one contiguous chunk per thread and waits for completion
+    * @note each thread always receives the same chunk for the same count
+    * @param count The amount of items in the range
+    * @param work The function to call with the begin/end of each chunk
+    */
+    void ParallelFor(int count, const RangeFn& work);
+
+    /**
+    * @return the amount of threads that work is split between including the caller
+    */
+    int GetThreadCount() const;
+
+private:
+
+    /**
+    * Prevent copying
+    */
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+    * Waits for and runs work for a worker thread
+    * @param thread The index of the thread the work is split between
+    */
+    void WorkerLoop(int thread);
+
+    /**
+    * Runs a thread's chunk of the current work
+    * @param thread The index of the thread the work is split between
+    */
+    void RunChunk(int thread);
+
+    std::vector<std::thread> m_workers;   ///< Threads that run work alongside the caller
+    std::mutex m_mutex;                   ///< Protects the shared work state
+    std::condition_variable m_start;      ///< Signals the workers that work is ready
+    std::condition_variable m_done;       ///< Signals the caller that all workers finished
+    const RangeFn* m_work;                ///< The current work to run
+    int m_count;                          ///< The amount of items in the current work
+    int m_pending;                        ///< Workers still running the current work
+    int m_generation;                     ///< Incremented each time new work is given
+    bool m_exit;                          ///< Whether the workers should finish
+};
@@ -8,8 +8,7 @@
 namespace
 {
     const double DT_INCREASE = 0.001; ///< Amount to change the forced deltatime
-    const double DT_MAXIMUM = 0.03;   ///< Maximum allowed deltatime
-    const double DT_MINIMUM = 0.01;   ///< Minimum allowed deltatime
+    const double DT_MAXIMUM = 0.1;    ///< Maximum allowed deltatime
 }
 
 Timer::Timer(EnginePtr engine) :
@@ -49,8 +48,7 @@ void Timer::UpdateTimer()
         m_fpsCounter = 0;
     }
 
-    m_deltaTime = max(deltatime, DT_MINIMUM);
-    m_deltaTime = min(m_deltaTime, DT_MAXIMUM);
+    m_deltaTime = min(deltatime, DT_MAXIMUM);
 
     if(m_engine->diagnostic()->AllowDiagnostics(Diagnostic::TEXT))
     {
@@ -88,4 +86,25 @@ void Timer::ToggleForceDeltatime()
 void Timer::ChangeDeltatime(bool increase)
 {
     m_forcedDeltatime += increase ? DT_INCREASE : -DT_INCREASE;
+}
+
+StopWatch::StopWatch() :
+    m_frequency(0.0)
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    m_frequency = static_cast<double>(frequency.QuadPart);
+    Start();
+}
+
+void StopWatch::Start()
+{
+    QueryPerformanceCounter(&m_start);
+}
+
+double StopWatch::GetElapsedMilliseconds() const
+{
+    LARGE_INTEGER current;
+    QueryPerformanceCounter(&current);
+    return static_cast<double>(current.QuadPart - m_start.QuadPart) * 1000.0 / m_frequency;
 }
\ No newline at end of file
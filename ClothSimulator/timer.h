@@ -58,3 +58,31 @@ private:
     double m_forcedDeltatime;   ///< The value for the forced deltatime
 };
 
+/**
+* High resolution timer for measuring the cost of a section of code
+*/
+class StopWatch
+{
+public:
+
+    /**
+    * Constructor; starts the stop watch
+    */
+    StopWatch();
+
+    /**
+    * Restarts the stop watch from zero
+    */
+    void Start();
+
+    /**
+    * @return The time passed since the stop watch was started in milliseconds
+    */
+    double GetElapsedMilliseconds() const;
+
+private:
+
+    double m_frequency;     ///< The frequency of the high-resolution performance counter
+    LARGE_INTEGER m_start;  ///< The time queried when the stop watch was started
+};
+